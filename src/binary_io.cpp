@@ -0,0 +1,80 @@
+#include "binary_io.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CPP2LS_HAVE_MMAP 1
+#endif
+
+namespace cpp2ls {
+
+  MappedFile::~MappedFile() { close(); }
+
+  bool MappedFile::open(const std::filesystem::path& path) {
+    close();
+
+#ifdef CPP2LS_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat info{};
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      return false;
+    }
+
+    m_size = static_cast<std::size_t>(info.st_size);
+    if (m_size > 0) {
+      void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        ::close(fd);
+        m_size = 0;
+        return false;
+      }
+      m_data = static_cast<const std::byte*>(data);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    return true;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      return false;
+    }
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) {
+      return false;
+    }
+    m_fallback.resize(size);
+    file.read(reinterpret_cast<char*>(m_fallback.data()),
+              static_cast<std::streamsize>(size));
+    m_data = m_fallback.data();
+    m_size = m_fallback.size();
+    return true;
+#endif
+  }
+
+  auto MappedFile::bytes() const -> std::span<const std::byte> {
+    return {m_data, m_size};
+  }
+
+  void MappedFile::close() {
+#ifdef CPP2LS_HAVE_MMAP
+    if (m_data) {
+      ::munmap(const_cast<std::byte*>(m_data), m_size);
+    }
+#endif
+    m_fallback.clear();
+    m_data = nullptr;
+    m_size = 0;
+  }
+
+}  // namespace cpp2ls
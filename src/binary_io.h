@@ -0,0 +1,120 @@
+#ifndef CPP2LS_BINARY_IO_H
+#define CPP2LS_BINARY_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace cpp2ls {
+
+  /// Read-only view of a whole file, memory-mapped where available
+  class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+    /// Map `path`; returns false if it can't be opened
+    bool open(const std::filesystem::path& path);
+
+    auto bytes() const -> std::span<const std::byte>;
+
+  private:
+    void close();
+
+    const std::byte* m_data{nullptr};
+    std::size_t m_size{0};
+    std::vector<std::byte> m_fallback;  // File contents when mmap is missing
+  };
+
+  /// Writes integers, strings and arrays of plain values in host byte order
+  ///
+  /// Arrays are written as a 64-bit element count followed by the raw
+  /// elements, so BinaryReader can copy them back in one block.
+  class BinaryWriter {
+  public:
+    explicit BinaryWriter(std::ostream& out) : m_out(out) {}
+
+    template <typename T>
+    void write(const T& value) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      m_out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void write_array(std::span<const T> values) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      write(static_cast<std::uint64_t>(values.size()));
+      m_out.write(reinterpret_cast<const char*>(values.data()),
+                  static_cast<std::streamsize>(values.size_bytes()));
+    }
+
+    void write_string(std::string_view text) {
+      write_array(std::span<const char>(text));
+    }
+
+  private:
+    std::ostream& m_out;
+  };
+
+  /// Reads what BinaryWriter wrote from a block of bytes
+  /// Throws std::runtime_error when the data ends early
+  class BinaryReader {
+  public:
+    explicit BinaryReader(std::span<const std::byte> bytes) : m_bytes(bytes) {}
+
+    template <typename T>
+    auto read() -> T {
+      static_assert(std::is_trivially_copyable_v<T>);
+      T value;
+      std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+      return value;
+    }
+
+    template <typename T>
+    void read_array(std::vector<T>& values) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      auto count = read<std::uint64_t>();
+      if (count > m_bytes.size() / sizeof(T)) {
+        throw std::runtime_error("truncated array");
+      }
+      auto block = take(count * sizeof(T));
+      values.resize(count);
+      std::memcpy(values.data(), block.data(), block.size());
+    }
+
+    auto read_string() -> std::string {
+      auto count = read<std::uint64_t>();
+      auto block = take(count);
+      return {reinterpret_cast<const char*>(block.data()), block.size()};
+    }
+
+    /// True once every byte was consumed
+    bool at_end() const { return m_bytes.empty(); }
+
+  private:
+    auto take(std::size_t size) -> std::span<const std::byte> {
+      if (size > m_bytes.size()) {
+        throw std::runtime_error("unexpected end of data");
+      }
+      auto block = m_bytes.first(size);
+      m_bytes = m_bytes.subspan(size);
+      return block;
+    }
+
+    std::span<const std::byte> m_bytes;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_BINARY_IO_H
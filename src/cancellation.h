@@ -0,0 +1,49 @@
+#ifndef CPP2LS_CANCELLATION_H
+#define CPP2LS_CANCELLATION_H
+
+#include <atomic>
+#include <memory>
+
+namespace cpp2ls {
+
+  /// Flag asking long-running work to stop early
+  ///
+  /// Copies share one flag. Whoever no longer wants the result calls
+  /// cancel(); the work polls cancelled() between units of work and returns
+  /// whatever it has, which the caller then throws away. Polling is a
+  /// relaxed atomic load, cheap enough for every loop iteration.
+  class CancellationToken {
+  public:
+    /// A token that is never cancelled
+    CancellationToken() = default;
+
+    /// A token that can be cancelled
+    static auto create() -> CancellationToken {
+      CancellationToken token;
+      token.m_flag = std::make_shared<std::atomic<bool>>(false);
+      return token;
+    }
+
+    /// Ask the work holding a copy of this token to stop; any thread
+    void cancel() const {
+      if (m_flag) {
+        m_flag->store(true, std::memory_order_relaxed);
+      }
+    }
+
+    /// Whether cancel() was called on this token or a copy of it
+    bool cancelled() const {
+      return m_flag && m_flag->load(std::memory_order_relaxed);
+    }
+
+    /// The shared flag, for code that can't hold a token, such as cppfront;
+    /// null for a token that is never cancelled
+    auto flag() const -> const std::atomic<bool>* { return m_flag.get(); }
+
+  private:
+    std::shared_ptr<std::atomic<bool>> m_flag;  // Null if never cancelled
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_CANCELLATION_H
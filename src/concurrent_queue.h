@@ -0,0 +1,142 @@
+#ifndef CPP2LS_CONCURRENT_QUEUE_H
+#define CPP2LS_CONCURRENT_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace cpp2ls {
+
+  /// Bounded lock-free queue from one producer thread to one consumer thread
+  ///
+  /// A ring of slots indexed by two counters, each written by one side only.
+  /// A side that finds the ring full or empty sleeps on the other side's
+  /// counter with std::atomic::wait, so neither spins nor takes a lock.
+  template <typename T>
+  class SpscQueue {
+  public:
+    /// Room for `capacity` items, rounded up to a power of two
+    explicit SpscQueue(std::size_t capacity)
+        : m_slots(std::bit_ceil(std::max<std::size_t>(capacity, 1))),
+          m_mask{m_slots.size() - 1} {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /// Append `value`, waiting while the queue is full
+    /// Producer only; returns false once the queue is closed
+    bool push(T value) {
+      auto tail = m_tail.load(std::memory_order_relaxed);
+      for (;;) {
+        if (m_closed.load(std::memory_order_acquire)) {
+          return false;
+        }
+        auto head = m_head.load(std::memory_order_acquire);
+        if (tail - head < m_slots.size()) {
+          break;
+        }
+        m_head.wait(head, std::memory_order_acquire);
+      }
+
+      m_slots[tail & m_mask] = std::move(value);
+      m_tail.store(tail + 1, std::memory_order_release);
+      m_tail.notify_one();
+      return true;
+    }
+
+    /// Remove the oldest item, waiting while the queue is empty
+    /// Consumer only
+    auto pop() -> T {
+      auto head = m_head.load(std::memory_order_relaxed);
+      while (m_tail.load(std::memory_order_acquire) == head) {
+        m_tail.wait(head, std::memory_order_acquire);
+      }
+
+      auto value = std::move(m_slots[head & m_mask]);
+      m_head.store(head + 1, std::memory_order_release);
+      m_head.notify_one();
+      return value;
+    }
+
+    /// Drop the queued items and fail every later push()
+    /// Consumer only; a producer waiting for room wakes up, as emptying the
+    /// full queue moves the head
+    void close() {
+      m_closed.store(true, std::memory_order_release);
+      m_head.store(m_tail.load(std::memory_order_acquire),
+                   std::memory_order_release);
+      m_head.notify_one();
+    }
+
+  private:
+    std::vector<T> m_slots;
+    std::size_t m_mask;
+
+    // On separate cache lines, as each is written by a different thread
+    alignas(64) std::atomic<std::size_t> m_head{0};  // Next slot to pop
+    alignas(64) std::atomic<std::size_t> m_tail{0};  // Next slot to push
+    std::atomic<bool> m_closed{false};
+  };
+
+  /// Unbounded lock-free queue from any number of threads to one consumer
+  ///
+  /// Producers push onto an intrusive stack with a compare-and-swap; the
+  /// consumer detaches the whole stack with one exchange and reverses it.
+  /// Taking everything queued at once suits consumers that batch their work.
+  template <typename T>
+  class MpscQueue {
+  public:
+    MpscQueue() = default;
+
+    ~MpscQueue() {
+      auto* node = m_head.load(std::memory_order_acquire);
+      while (node) {
+        delete std::exchange(node, node->next);
+      }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /// Append `value`; any thread, never waits
+    void push(T value) {
+      auto* node = new Node{std::move(value), nullptr};
+      node->next = m_head.load(std::memory_order_relaxed);
+      while (!m_head.compare_exchange_weak(node->next, node,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+      }
+      m_head.notify_one();
+    }
+
+    /// Remove every queued item, oldest first, waiting while there are none
+    /// Consumer only
+    auto take_all() -> std::vector<T> {
+      Node* node;
+      while (!(node = m_head.exchange(nullptr, std::memory_order_acquire))) {
+        m_head.wait(nullptr, std::memory_order_acquire);
+      }
+
+      std::vector<T> values;
+      for (; node; delete std::exchange(node, node->next)) {
+        values.push_back(std::move(node->value));
+      }
+      std::ranges::reverse(values);
+      return values;
+    }
+
+  private:
+    struct Node {
+      T value;
+      Node* next;
+    };
+
+    std::atomic<Node*> m_head{nullptr};  // Newest item
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_CONCURRENT_QUEUE_H
@@ -0,0 +1,90 @@
+#include "content_hash.h"
+
+#include <bit>
+#include <cstring>
+
+namespace cpp2ls {
+
+  namespace {
+    constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+    constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ull;
+    constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+    constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+    /// Little-endian load, as the hash is defined on LE words
+    template <typename T>
+    auto load(const char* ptr) -> T {
+      T value;
+      std::memcpy(&value, ptr, sizeof(value));
+      if constexpr (std::endian::native == std::endian::big) {
+        value = std::byteswap(value);
+      }
+      return value;
+    }
+
+    auto round(std::uint64_t acc, std::uint64_t input) -> std::uint64_t {
+      acc += input * kPrime2;
+      acc = std::rotl(acc, 31);
+      return acc * kPrime1;
+    }
+
+    auto merge_round(std::uint64_t acc, std::uint64_t lane) -> std::uint64_t {
+      acc ^= round(0, lane);
+      return acc * kPrime1 + kPrime4;
+    }
+  }  // namespace
+
+  auto content_hash(std::string_view bytes, std::uint64_t seed)
+      -> std::uint64_t {
+    const char* ptr = bytes.data();
+    const char* end = ptr + bytes.size();
+    std::uint64_t hash;
+
+    if (bytes.size() >= 32) {
+      std::uint64_t v1 = seed + kPrime1 + kPrime2;
+      std::uint64_t v2 = seed + kPrime2;
+      std::uint64_t v3 = seed;
+      std::uint64_t v4 = seed - kPrime1;
+      for (; end - ptr >= 32; ptr += 32) {
+        v1 = round(v1, load<std::uint64_t>(ptr));
+        v2 = round(v2, load<std::uint64_t>(ptr + 8));
+        v3 = round(v3, load<std::uint64_t>(ptr + 16));
+        v4 = round(v4, load<std::uint64_t>(ptr + 24));
+      }
+      hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12)
+             + std::rotl(v4, 18);
+      hash = merge_round(hash, v1);
+      hash = merge_round(hash, v2);
+      hash = merge_round(hash, v3);
+      hash = merge_round(hash, v4);
+    } else {
+      hash = seed + kPrime5;
+    }
+
+    hash += bytes.size();
+
+    for (; end - ptr >= 8; ptr += 8) {
+      hash ^= round(0, load<std::uint64_t>(ptr));
+      hash = std::rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (end - ptr >= 4) {
+      hash ^= load<std::uint32_t>(ptr) * kPrime1;
+      hash = std::rotl(hash, 23) * kPrime2 + kPrime3;
+      ptr += 4;
+    }
+    for (; ptr < end; ++ptr) {
+      hash ^= static_cast<unsigned char>(*ptr) * kPrime5;
+      hash = std::rotl(hash, 11) * kPrime1;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,21 @@
+#ifndef CPP2LS_CONTENT_HASH_H
+#define CPP2LS_CONTENT_HASH_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace cpp2ls {
+
+  /// 64-bit hash of a file's bytes, to tell whether it really changed
+  ///
+  /// This is XXH64: it consumes 32 bytes per round in four independent
+  /// lanes, so it runs at memory speed and costs far less than the parse it
+  /// saves. The values match the reference implementation for `seed`.
+  /// Passing each result as the next call's seed hashes a sequence of
+  /// pieces; every piece mixes in its length, so their boundaries count.
+  auto content_hash(std::string_view bytes, std::uint64_t seed = 0)
+      -> std::uint64_t;
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_CONTENT_HASH_H
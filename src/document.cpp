@@ -1,10 +1,12 @@
 #include "document.h"
 
-#include <filesystem>
-#include <fstream>
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <sstream>
+#include <unordered_set>
+
+#include "content_hash.h"
 
 // Include cppfront headers
 // Note: These must be included in a specific order due to dependencies
@@ -16,147 +18,536 @@
 
 namespace cpp2ls {
 
-  Cpp2Document::Cpp2Document(std::string uri) : m_uri{std::move(uri)} {
-    m_errors = new std::vector<cpp2::error_entry>();
-  }
+  namespace {
+    /// Hash of lines [first, last] of `lines`
+    auto hash_lines(const std::vector<cpp2::source_line>& lines, int first,
+                    int last) -> std::uint64_t {
+      std::uint64_t hash = 0;
+      for (int i = first; i <= last; ++i) {
+        hash = content_hash(lines[i].text, hash);
+      }
+      return hash;
+    }
 
-  Cpp2Document::~Cpp2Document() { delete m_errors; }
-
-  Cpp2Document::Cpp2Document(Cpp2Document&& other) noexcept
-      : m_uri{std::move(other.m_uri)},
-        m_content{std::move(other.m_content)},
-        m_errors{other.m_errors},
-        m_source{std::move(other.m_source)},
-        m_tokens{std::move(other.m_tokens)},
-        m_parser{std::move(other.m_parser)},
-        m_sema{std::move(other.m_sema)},
-        m_valid{other.m_valid} {
-    other.m_errors = nullptr;
-  }
+    /// Index the declarations found by `sema` into `model`
+    void build_model(const cpp2::sema& sema, DocumentModel& model) {
+      for (const auto& sym : sema.symbols) {
+        if (!sym.is_declaration() || !sym.start) {
+          continue;
+        }
+
+        const auto& decl_sym = sym.as_declaration();
+        if (!decl_sym.declaration || !decl_sym.identifier) {
+          continue;
+        }
+
+        const auto* decl = decl_sym.declaration;
+        model.add_declaration(decl_sym.identifier->to_string(), &decl_sym);
+
+        if (decl->parent_declaration && decl->parent_declaration->is_type()) {
+          model.add_member(decl->parent_declaration, &decl_sym);
+        }
+
+        // Global functions are UFCS candidates for their first parameter's
+        // type
+        if (!decl->is_function() || decl->parent_declaration
+            || decl->type.index() != cpp2::declaration_node::a_function) {
+          continue;
+        }
+        const auto* func_type
+            = std::get<cpp2::declaration_node::a_function>(decl->type).get();
+        if (!func_type || !func_type->parameters
+            || func_type->parameters->ssize() == 0) {
+          continue;
+        }
+        const auto* first_param = (*func_type->parameters)[0];
+        if (!first_param || !first_param->declaration
+            || !first_param->declaration->is_object()) {
+          continue;
+        }
+        // Use safe object_type() method
+        auto first_param_type = first_param->declaration->object_type();
+        if (!first_param_type.empty()
+            && first_param_type.find("(*ERROR*)") == std::string::npos) {
+          model.add_ufcs_candidate(std::move(first_param_type), &decl_sym);
+        }
+      }
+    }
 
-  Cpp2Document& Cpp2Document::operator=(Cpp2Document&& other) noexcept {
-    if (this != &other) {
-      delete m_errors;
-      m_uri = std::move(other.m_uri);
-      m_content = std::move(other.m_content);
-      m_errors = other.m_errors;
-      m_source = std::move(other.m_source);
-      m_tokens = std::move(other.m_tokens);
-      m_parser = std::move(other.m_parser);
-      m_sema = std::move(other.m_sema);
-      m_valid = other.m_valid;
-      other.m_errors = nullptr;
+    /// Position of the ';' ending a declaration without a braced body
+    auto expression_end(const TokenTable& tokens,
+                        const cpp2::declaration_node& decl)
+        -> SourcePosition {
+      auto from = decl.equal_sign.lineno > 0 ? decl.equal_sign
+                                             : decl.position();
+      const auto& entries = tokens.entries();
+      int depth = 0;
+      for (auto index = tokens.lower_bound(from.lineno, from.colno);
+           index < entries.size(); ++index) {
+        const auto& entry = entries[index];
+        if (entry.text == "(" || entry.text == "[" || entry.text == "{") {
+          ++depth;
+        } else if (entry.text == ")" || entry.text == "]"
+                   || entry.text == "}") {
+          --depth;
+        }
+        if ((entry.text == ";" && depth == 0) || depth < 0) {
+          return {entry.line, entry.column};
+        }
+      }
+      if (entries.empty()) {
+        return {from.lineno, from.colno};
+      }
+      return {entries.back().line, entries.back().column};
     }
-    return *this;
-  }
 
-  void Cpp2Document::update(const std::string& content) {
-    m_content = content;
-    m_valid = false;
-    m_errors->clear();
-
-    // Reset parsing state
-    m_source.reset();
-    m_tokens.reset();
-    m_parser.reset();
-    m_sema.reset();
-
-    // Wrap all parsing in try-catch to handle cppfront exceptions
-    // (e.g., "unexpected end of source file")
-    try {
-      // Create a temporary file for the content
-      // (cppfront's source class reads from files)
-      auto temp_path
-          = std::filesystem::temp_directory_path() / "cpp2ls_temp.cpp2";
-      {
-        std::ofstream temp_file(temp_path);
-        if (!temp_file) {
-          m_errors->emplace_back(cpp2::source_position{1, 1},
-                                 "Failed to create temporary file for parsing");
-          return;
+    /// Build the scope tree of a section from its sema symbols
+    void build_scopes(const cpp2::sema& sema, const TokenTable& tokens,
+                      ScopeTree& scopes) {
+      // Bodies of functions, types and namespaces belong to the scope of
+      // the declaration rather than forming a block of their own
+      std::unordered_set<const cpp2::compound_statement_node*> bodies;
+
+      for (const auto& sym : sema.symbols) {
+        if (!sym.start) {
+          continue;
+        }
+
+        if (sym.is_compound()) {
+          const auto* compound = sym.as_compound().compound;
+          if (compound && !bodies.contains(compound)) {
+            scopes.add_scope(
+                ScopeTree::Kind::Block, nullptr,
+                {compound->open_brace.lineno, compound->open_brace.colno},
+                {compound->close_brace.lineno, compound->close_brace.colno});
+          }
+          continue;
+        }
+
+        if (!sym.is_declaration()) {
+          continue;
+        }
+        const auto& decl_sym = sym.as_declaration();
+        if (!decl_sym.declaration || !decl_sym.identifier) {
+          continue;
+        }
+
+        const auto* decl = decl_sym.declaration;
+        auto pos = decl->position();
+        SourcePosition start{pos.lineno, pos.colno};
+        scopes.add_declaration(&decl_sym, decl, start);
+
+        ScopeTree::Kind kind;
+        if (decl->is_function()) {
+          kind = ScopeTree::Kind::Function;
+        } else if (decl->is_type()) {
+          kind = ScopeTree::Kind::Type;
+        } else if (decl->is_namespace()) {
+          kind = ScopeTree::Kind::Namespace;
+        } else {
+          continue;
+        }
+
+        const cpp2::compound_statement_node* body = nullptr;
+        if (decl->initializer) {
+          body = decl->initializer->get_if<cpp2::compound_statement_node>();
+        }
+        if (body) {
+          bodies.insert(body);
+          scopes.add_scope(kind, decl, start,
+                           {body->close_brace.lineno, body->close_brace.colno});
+        } else {
+          scopes.add_scope(kind, decl, start, expression_end(tokens, *decl));
         }
-        temp_file << content;
       }
 
-      // Initialize cppfront components
-      m_source = std::make_unique<cpp2::source>(*m_errors);
-      if (!m_source->load(temp_path.string())) {
-        // Remove temp file
-        std::filesystem::remove(temp_path);
-        return;
+      scopes.finalize();
+    }
+
+    /// Invert sema's token-to-declaration map into per-declaration postings
+    void build_postings(const cpp2::sema& sema, const TokenTable& tokens,
+                        ReferencePostings& postings) {
+      for (const auto& [tok, decl_info] : sema.declaration_of) {
+        if (!tok || !decl_info.sym) {
+          continue;
+        }
+        auto pos = tok->position();
+        postings.add(decl_info.sym, {pos.lineno, pos.colno});
+      }
+
+      for (const auto& entry : tokens.entries()) {
+        if (entry.is_identifier
+            && !sema.get_declaration_of(entry.token, true)) {
+          postings.add_unresolved(std::string(entry.text),
+                                  {entry.line, entry.column});
+        }
       }
 
-      // Remove temp file now that we've loaded it
-      std::filesystem::remove(temp_path);
+      postings.finalize();
+    }
+
+    /// Run lex/parse/sema over lines [first, last] of `lines`, numbering
+    /// them from 1
+    auto parse_section(const std::vector<cpp2::source_line>& lines, int first,
+                       int last, std::uint64_t hash)
+        -> std::shared_ptr<const SectionParse> {
+      auto section = std::make_shared<SectionParse>();
+      section->hash = hash;
+      auto& errors = section->errors;
+
+      // Tokens may point into text cppfront generated on this thread; the
+      // section takes it along, also when a cancelled run unwinds from here
+      cpp2::finally take_generated{[owner = section.get()] {
+        owner->generated = std::make_unique<cpp2::generated_storage>(
+            cpp2::take_generated_storage());
+      }};
+
+      try {
+        // Copy the slice so the section owns the text its tokens point into;
+        // index 0 is the blank entry cppfront expects in front of line 1
+        section->lines.reserve(last - first + 2);
+        section->lines.emplace_back();
+        section->lines.insert(section->lines.end(), lines.begin() + first,
+                              lines.begin() + last + 1);
+
+        section->tokens = std::make_unique<cpp2::tokens>(errors);
+        section->tokens->lex(section->lines, false);
+
+        std::vector<TokenTable::Entry> entries;
+        for (const auto& [lineno, section_tokens] :
+             section->tokens->get_map()) {
+          for (const auto& token : section_tokens) {
+            auto pos = token.position();
+            entries.push_back({&token, pos.lineno, pos.colno, token.length(),
+                               token.as_string_view(),
+                               token.type() == cpp2::lexeme::Identifier});
+          }
+        }
+        section->token_table.build(std::move(entries), 1, last - first + 1);
+
+        section->parser
+            = std::make_unique<cpp2::parser>(errors, section->includes);
+        for (const auto& [lineno, section_tokens] :
+             section->tokens->get_map()) {
+          // Keep going on errors to collect more of them
+          section->parser->parse(section_tokens,
+                                 section->tokens->get_generated());
+        }
 
-      // Check if there's any cpp2 code to parse
-      if (!m_source->has_cpp2()) {
-        // No cpp2 code - this is valid but there's nothing to parse
-        m_valid = true;
-        return;
+        section->sema = std::make_unique<cpp2::sema>(errors);
+        section->parser->visit(*section->sema);
+        section->sema->apply_local_rules();
+        build_model(*section->sema, section->model);
+        build_scopes(*section->sema, section->token_table, section->scopes);
+        build_postings(*section->sema, section->token_table,
+                       section->postings);
+
+        section->valid = errors.empty();
+      } catch (const std::exception& e) {
+        // Cppfront threw an exception (e.g., unexpected EOF)
+        // Add it as an error; the document keeps its cached results
+        errors.emplace_back(cpp2::source_position{1, 1},
+                            std::string("Parser exception: ") + e.what());
+        section->valid = false;
       }
 
-      // Lex the source
-      m_tokens = std::make_unique<cpp2::tokens>(*m_errors);
-      m_tokens->lex(m_source->get_lines());
+      return section;
+    }
+  }  // namespace
 
-      // Parse the tokens
-      std::set<std::string> includes;
-      m_parser = std::make_unique<cpp2::parser>(*m_errors, includes);
+  SectionParse::SectionParse() = default;
 
-      // Parse each section of cpp2 code
-      for (const auto& [lineno, section_tokens] : m_tokens->get_map()) {
-        if (!m_parser->parse(section_tokens, m_tokens->get_generated())) {
-          // Parse error - continue to collect more errors
-          continue;
+  SectionParse::~SectionParse() = default;
+
+  ParseResult::ParseResult() = default;
+
+  ParseResult::~ParseResult() = default;
+
+  auto ParseResult::section_at(int line) const -> const PlacedSection* {
+    if (sections.empty()) {
+      return nullptr;
+    }
+    auto it = std::upper_bound(
+        sections.begin(), sections.end(), line,
+        [](int l, const auto& section) { return l < section.first_line; });
+    return it == sections.begin() ? &sections.front() : &*std::prev(it);
+  }
+
+  Cpp2Document::Cpp2Document(std::string uri) : m_uri{std::move(uri)} {}
+
+  void Cpp2Document::update(const std::string& content) {
+    set_text(content);
+    reparse();
+  }
+
+  void Cpp2Document::set_text(std::string content) {
+    m_buffer.assign(std::move(content));
+    m_column_maps.maps.clear();
+    ++m_revision;
+  }
+
+  void Cpp2Document::apply_edit(int start_line, int start_col, int end_line,
+                                int end_col, std::string_view text) {
+    auto start = m_buffer.offset_of(start_line, start_col);
+    auto end = m_buffer.offset_of(end_line, end_col);
+    m_buffer.replace(start, end, text);
+    ++m_revision;
+
+    // Edits within a line leave the tables of all other lines valid
+    if (start_line == end_line && text.find('\n') == std::string_view::npos) {
+      m_column_maps.maps.erase(start_line);
+    } else {
+      m_column_maps.maps.clear();
+    }
+  }
+
+  auto Cpp2Document::text() const -> std::string_view {
+    return m_buffer.text();
+  }
+
+  auto Cpp2Document::size() const -> std::size_t { return m_buffer.size(); }
+
+  auto Cpp2Document::line(int line) const -> std::string_view {
+    return m_buffer.line(line);
+  }
+
+  auto Cpp2Document::lines() const -> const LineIndex& {
+    return m_buffer.lines();
+  }
+
+  auto Cpp2Document::to_byte_column(int line, int col,
+                                    PositionEncoding encoding) const -> int {
+    if (encoding == PositionEncoding::Utf8) {
+      return col;
+    }
+    return column_map(line).to_bytes(col, encoding);
+  }
+
+  auto Cpp2Document::from_byte_column(int line, int byte_col,
+                                      PositionEncoding encoding) const -> int {
+    if (encoding == PositionEncoding::Utf8) {
+      return byte_col;
+    }
+    return column_map(line).from_bytes(byte_col, encoding);
+  }
+
+  auto Cpp2Document::column_map(int line) const -> const ColumnMap& {
+    // References into the map stay valid as other lines are added
+    std::lock_guard lock{m_column_maps.mutex};
+    auto& maps = m_column_maps.maps;
+    auto it = maps.find(line);
+    if (it == maps.end()) {
+      it = maps.emplace(line, ColumnMap{m_buffer.line(line)}).first;
+    }
+    return it->second;
+  }
+
+  auto Cpp2Document::revision() const -> std::uint64_t { return m_revision; }
+
+  auto Cpp2Document::parsed_revision() const -> std::uint64_t {
+    return m_parsed_revision;
+  }
+
+  void Cpp2Document::reparse() {
+    install(parse(m_buffer.text(), m_parse.get()), m_revision);
+  }
+
+  auto Cpp2Document::parse(std::string_view text, const ParseResult* previous,
+                           const CancellationToken& cancel)
+      -> std::shared_ptr<const ParseResult> {
+    // cppfront's lexer/parser bookkeeping (generated_text,
+    // current_expressions, ...) is thread_local, so parses on different
+    // threads don't interfere. Each section takes the text generated for it
+    // off the thread, so results outlive the pool worker that made them.
+
+    auto result = std::make_shared<ParseResult>();
+    result->content_hash = content_hash(text);
+    result->content_size = text.size();
+
+    // Load straight from the in-memory buffer so concurrent parses don't
+    // share any on-disk state; this only splits and categorizes the lines
+    auto source = std::make_unique<cpp2::source>(result->errors);
+    if (!source->load_from_memory(text)) {
+      return result;
+    }
+
+    const auto& lines = source->get_lines();
+    auto line_count = static_cast<int>(lines.size());
+    bool valid = result->errors.empty();
+
+    // cppfront polls the flag of the thread it runs on; a cancelled run
+    // unwinds out of it, dropping the section it was in
+    cpp2::cancel_flag = cancel.flag();
+    cpp2::finally reset_flag{[] { cpp2::cancel_flag = nullptr; }};
+
+    // Sections don't depend on where they are, so any earlier one with the
+    // same text will do, including one parsed earlier in this run
+    std::unordered_map<std::uint64_t, std::shared_ptr<const SectionParse>>
+        reusable;
+    if (previous) {
+      for (const auto& old : previous->sections) {
+        reusable.try_emplace(old.parse->hash, old.parse);
+      }
+    }
+
+    // Each run of Cpp2 lines is a section; unchanged ones are reused as-is
+    for (int first = 1; first < line_count; ++first) {
+      if (lines[first].cat != cpp2::source_line::category::cpp2) {
+        continue;
+      }
+      int last = first;
+      while (last + 1 < line_count
+             && lines[last + 1].cat == cpp2::source_line::category::cpp2) {
+        ++last;
+      }
+
+      auto hash = hash_lines(lines, first, last);
+      auto& section = reusable[hash];
+      if (!section) {
+        try {
+          section = parse_section(lines, first, last, hash);
+        } catch (const cpp2::parse_cancelled&) {
+          return nullptr;
         }
       }
 
-      // Run semantic analysis
-      m_sema = std::make_unique<cpp2::sema>(*m_errors);
-      m_parser->visit(*m_sema);
-      m_sema->apply_local_rules();
-
-      m_valid = m_errors->empty();
-    } catch (const std::exception& e) {
-      // Cppfront threw an exception (e.g., unexpected EOF)
-      // Add it as an error and keep cached results if available
-      m_errors->emplace_back(cpp2::source_position{1, 1},
-                             std::string("Parser exception: ") + e.what());
-      m_valid = false;
-      // Don't clear cached results - they're still useful
-      return;
+      valid = valid && section->valid;
+      result->sections.push_back({section, first, last});
+      first = last;
     }
 
+    // No cpp2 code at all is valid, there's just nothing to analyze
+    result->valid = valid;
+    return result;
+  }
+
+  auto Cpp2Document::parse_result() const
+      -> std::shared_ptr<const ParseResult> {
+    return m_parse;
+  }
+
+  auto Cpp2Document::snapshot() const -> std::shared_ptr<const Cpp2Document> {
+    // The copy shares the text and line index, so reading it never writes
+    // to it and taking it copies nothing once the text is materialized
+    auto copy = std::make_shared<Cpp2Document>(m_uri);
+    copy->m_buffer = m_buffer.snapshot();
+    copy->m_revision = m_revision;
+    copy->m_parsed_revision = m_parsed_revision;
+    copy->m_parse = m_parse;
+    copy->m_cached = m_cached;
+    return copy;
+  }
+
+  void Cpp2Document::install(std::shared_ptr<const ParseResult> result,
+                             std::uint64_t revision) {
+    m_parse = std::move(result);
+    m_parsed_revision = revision;
+
     // Cache successful parse results for use during editing
     // Note: We can't copy sema because it has a reference member,
     // so we only cache when the parse is successful
-    if (m_valid && m_sema && !m_sema->symbols.empty()) {
-      // Move current results to cache
-      m_cached_source = std::move(m_source);
-      m_cached_tokens = std::move(m_tokens);
-      m_cached_parser = std::move(m_parser);
-      m_cached_sema = std::move(m_sema);
-
-      // NOTE: After moving to cache, m_sema is nullptr
-      // This is intentional - for valid files, we use cached_sema
+    if (m_parse && m_parse->valid
+        && std::any_of(m_parse->sections.begin(), m_parse->sections.end(),
+                       [](const auto& section) {
+                         return section.parse->sema
+                                && !section.parse->sema->symbols.empty();
+                       })) {
+      m_cached = m_parse;
+    }
+  }
+
+  auto Cpp2Document::active_section(int line) const -> const PlacedSection* {
+    if (m_parse) {
+      if (const auto* section = m_parse->section_at(line);
+          section && section->parse->sema) {
+        return section;
+      }
+    }
+    if (m_cached) {
+      if (const auto* section = m_cached->section_at(line);
+          section && section->parse->sema) {
+        return section;
+      }
+    }
+    return nullptr;
+  }
+
+  auto Cpp2Document::completion_section(int line) const
+      -> const PlacedSection* {
+    // Use the cached section if:
+    // 1. The current one has no sema or no symbols, OR
+    // 2. It has parse errors and the cached one has more symbols
+    const auto* current = m_parse ? m_parse->section_at(line) : nullptr;
+    const auto* cached = m_cached ? m_cached->section_at(line) : nullptr;
+    if (cached && cached->parse->sema) {
+      auto current_symbols = current && current->parse->sema
+                                 ? current->parse->sema->symbols.size()
+                                 : 0;
+      bool current_empty = current_symbols == 0;
+      bool cached_has_more
+          = cached->parse->sema->symbols.size() > current_symbols;
+      if (current_empty || (!current->parse->valid && cached_has_more)) {
+        return cached;
+      }
+    }
+    return current && current->parse->sema ? current : nullptr;
+  }
+
+  auto Cpp2Document::active_sections() const
+      -> std::vector<const PlacedSection*> {
+    std::vector<const PlacedSection*> result;
+    const auto* sections = m_parse && !m_parse->sections.empty()
+                               ? m_parse.get()
+                               : m_cached.get();
+    if (!sections) {
+      return result;
+    }
+
+    for (const auto& section : sections->sections) {
+      const PlacedSection* to_use = section.parse->sema ? &section : nullptr;
+      if (!to_use && m_cached) {
+        to_use = m_cached->section_at(section.first_line);
+        if (to_use && !to_use->parse->sema) {
+          to_use = nullptr;
+        }
+      }
+      if (to_use && std::find(result.begin(), result.end(), to_use)
+                        == result.end()) {
+        result.push_back(to_use);
+      }
+    }
+    return result;
+  }
+
+  auto Cpp2Document::find_global_declaration(const std::string& name,
+                                             const PlacedSection* except) const
+      -> std::pair<const PlacedSection*, const cpp2::declaration_sym*> {
+    for (const auto* section : active_sections()) {
+      if (section == except) {
+        continue;
+      }
+      for (const auto* decl_sym :
+           section->parse->model.declarations_named(name)) {
+        if (decl_sym->declaration->is_global()) {
+          return {section, decl_sym};
+        }
+      }
     }
+    return {nullptr, nullptr};
   }
 
   auto Cpp2Document::get_hover_info(int line, int col,
                                     const ProjectIndex* index) const
       -> std::optional<HoverInfo> {
-    // Use cached sema if current is null
-    const cpp2::sema* sema_to_use = m_sema ? m_sema.get() : m_cached_sema.get();
-    const cpp2::tokens* tokens_to_use
-        = m_tokens ? m_tokens.get() : m_cached_tokens.get();
-
-    if (!sema_to_use || !tokens_to_use) {
+    // Use the cached section if the current one didn't get to sema
+    const auto* section = active_section(line + 1);
+    if (!section) {
       return std::nullopt;
     }
+    const cpp2::sema* sema_to_use = section->parse->sema.get();
 
     // Convert from 0-based (LSP) to 1-based (cppfront)
-    const auto* token = find_token_at(line + 1, col + 1);
+    const auto* token = find_token_at(*section, line + 1, col + 1);
     if (!token) {
       return std::nullopt;
     }
@@ -169,9 +560,25 @@ namespace cpp2ls {
 
       // Set range from token position (convert back to 0-based)
       auto pos = token->position();
-      info.start_line = pos.lineno - 1;
+      info.start_line = section->to_document(pos.lineno) - 1;
+      info.start_col = pos.colno - 1;
+      info.end_line = info.start_line;
+      info.end_col = pos.colno - 1 + token->length();
+
+      return info;
+    }
+
+    // Globals declared in another section of this file
+    auto name = token->to_string();
+    if (auto [other, global] = find_global_declaration(name, section);
+        global) {
+      HoverInfo info;
+      info.contents = build_hover_content(*global);
+
+      auto pos = token->position();
+      info.start_line = section->to_document(pos.lineno) - 1;
       info.start_col = pos.colno - 1;
-      info.end_line = pos.lineno - 1;
+      info.end_line = info.start_line;
       info.end_col = pos.colno - 1 + token->length();
 
       return info;
@@ -179,16 +586,15 @@ namespace cpp2ls {
 
     // Fallback: use global index for cross-file and forward reference lookup
     if (index) {
-      auto name = token->to_string();
       auto symbols = index->lookup(name);
       if (!symbols.empty()) {
         HoverInfo info;
-        info.contents = build_hover_content(*symbols[0]);
+        info.contents = build_hover_content(index->symbol(symbols[0]));
 
         auto pos = token->position();
-        info.start_line = pos.lineno - 1;
+        info.start_line = section->to_document(pos.lineno) - 1;
         info.start_col = pos.colno - 1;
-        info.end_line = pos.lineno - 1;
+        info.end_line = info.start_line;
         info.end_col = pos.colno - 1 + token->length();
 
         return info;
@@ -198,24 +604,56 @@ namespace cpp2ls {
     return std::nullopt;
   }
 
+  auto Cpp2Document::included_files() const
+      -> std::vector<std::filesystem::path> {
+    std::vector<std::filesystem::path> result;
+    auto dir = ProjectIndex::uri_to_path(m_uri).parent_path();
+
+    for (int i = 0; i < m_buffer.lines().line_count(); ++i) {
+      auto text = line(i);
+      auto start = text.find_first_not_of(" \t");
+      if (start == std::string_view::npos || text[start] != '#') {
+        continue;
+      }
+      text.remove_prefix(start + 1);
+      text.remove_prefix(std::min(text.find_first_not_of(" \t"), text.size()));
+      if (!text.starts_with("include")) {
+        continue;
+      }
+
+      // Only quoted includes can name workspace files
+      auto open = text.find('"');
+      auto close = open == std::string_view::npos
+                       ? std::string_view::npos
+                       : text.find('"', open + 1);
+      if (close == std::string_view::npos) {
+        continue;
+      }
+      result.push_back(
+          (dir / text.substr(open + 1, close - open - 1)).lexically_normal());
+    }
+
+    return result;
+  }
+
   auto Cpp2Document::uri() const -> const std::string& { return m_uri; }
 
-  auto Cpp2Document::is_valid() const -> bool { return m_valid; }
+  auto Cpp2Document::is_valid() const -> bool {
+    return m_parse && m_parse->valid;
+  }
 
   auto Cpp2Document::get_definition_location(int line, int col,
                                              const ProjectIndex* index) const
       -> std::optional<LocationInfo> {
-    // Use cached sema if current is null
-    const cpp2::sema* sema_to_use = m_sema ? m_sema.get() : m_cached_sema.get();
-    const cpp2::tokens* tokens_to_use
-        = m_tokens ? m_tokens.get() : m_cached_tokens.get();
-
-    if (!sema_to_use || !tokens_to_use) {
+    // Use the cached section if the current one didn't get to sema
+    const auto* section = active_section(line + 1);
+    if (!section) {
       return std::nullopt;
     }
+    const cpp2::sema* sema_to_use = section->parse->sema.get();
 
     // Convert from 0-based (LSP) to 1-based (cppfront)
-    const auto* token = find_token_at(line + 1, col + 1);
+    const auto* token = find_token_at(*section, line + 1, col + 1);
     if (!token) {
       return std::nullopt;
     }
@@ -227,20 +665,33 @@ namespace cpp2ls {
 
       LocationInfo loc;
       loc.uri = m_uri;  // Same file
-      loc.line = pos.lineno - 1;
+      loc.line = section->to_document(pos.lineno) - 1;
+      loc.column = pos.colno - 1;
+      return loc;
+    }
+
+    // Globals declared in another section of this file
+    auto name = token->to_string();
+    if (auto [other, global] = find_global_declaration(name, section);
+        global) {
+      auto pos = global->position();
+
+      LocationInfo loc;
+      loc.uri = m_uri;
+      loc.line = other->to_document(pos.lineno) - 1;
       loc.column = pos.colno - 1;
       return loc;
     }
 
     // Fallback: use global index for cross-file lookup
     if (index) {
-      auto name = token->to_string();
       auto symbols = index->lookup(name);
       if (!symbols.empty()) {
+        auto sym = index->symbol(symbols[0]);
         LocationInfo loc;
-        loc.uri = symbols[0]->file_uri;
-        loc.line = symbols[0]->line;
-        loc.column = symbols[0]->column;
+        loc.uri = sym.file_uri;
+        loc.line = sym.line;
+        loc.column = sym.column;
         return loc;
       }
     }
@@ -249,21 +700,20 @@ namespace cpp2ls {
   }
 
   auto Cpp2Document::get_references(int line, int col, bool include_declaration,
-                                    const ProjectIndex* index) const
+                                    const ProjectIndex* index,
+                                    const CancellationToken& cancel) const
       -> std::vector<LocationInfo> {
     std::vector<LocationInfo> result;
 
-    // Use cached sema if current is null
-    const cpp2::sema* sema_to_use = m_sema ? m_sema.get() : m_cached_sema.get();
-    const cpp2::tokens* tokens_to_use
-        = m_tokens ? m_tokens.get() : m_cached_tokens.get();
-
-    if (!sema_to_use || !tokens_to_use) {
+    // Use the cached section if the current one didn't get to sema
+    const auto* section = active_section(line + 1);
+    if (!section) {
       return result;
     }
+    const cpp2::sema* sema_to_use = section->parse->sema.get();
 
     // Convert from 0-based (LSP) to 1-based (cppfront)
-    const auto* token = find_token_at(line + 1, col + 1);
+    const auto* token = find_token_at(*section, line + 1, col + 1);
     if (!token) {
       return result;
     }
@@ -279,7 +729,7 @@ namespace cpp2ls {
         auto pos = target_decl->position();
         LocationInfo loc;
         loc.uri = m_uri;
-        loc.line = pos.lineno - 1;
+        loc.line = section->to_document(pos.lineno) - 1;
         loc.column = pos.colno - 1;
         result.push_back(loc);
       }
@@ -289,26 +739,38 @@ namespace cpp2ls {
         symbol_name = target_decl->declaration->name()->to_string();
       }
 
-      // Find all references in this file via cppfront's declaration_of map
-      for (const auto& [tok, decl_info] : sema_to_use->declaration_of) {
-        if (!tok || !decl_info.sym) {
+      // Find all references in this file via the section's postings
+      auto declared_at = target_decl->position();
+      for (const auto& occurrence :
+           section->parse->postings.occurrences_of(target_decl)) {
+        // Skip declaration itself
+        if (include_declaration && occurrence.line == declared_at.lineno
+            && occurrence.column == declared_at.colno) {
           continue;
         }
 
-        if (decl_info.sym == target_decl) {
-          auto pos = tok->position();
-          // Skip declaration itself
-          if (include_declaration
-              && pos.lineno - 1 == target_decl->position().lineno - 1
-              && pos.colno - 1 == target_decl->position().colno - 1) {
+        LocationInfo loc;
+        loc.uri = m_uri;
+        loc.line = section->to_document(occurrence.line) - 1;
+        loc.column = occurrence.column - 1;
+        result.push_back(loc);
+      }
+
+      // Sections are analyzed separately, so uses of a global declaration
+      // in other sections show up there as unresolved identifiers
+      if (target_decl->declaration->is_global() && !symbol_name.empty()) {
+        for (const auto* other : active_sections()) {
+          if (other == section) {
             continue;
           }
-
-          LocationInfo loc;
-          loc.uri = m_uri;
-          loc.line = pos.lineno - 1;
-          loc.column = pos.colno - 1;
-          result.push_back(loc);
+          for (const auto& occurrence :
+               other->parse->postings.unresolved(symbol_name)) {
+            LocationInfo loc;
+            loc.uri = m_uri;
+            loc.line = other->to_document(occurrence.line) - 1;
+            loc.column = occurrence.column - 1;
+            result.push_back(loc);
+          }
         }
       }
     } else {
@@ -319,24 +781,68 @@ namespace cpp2ls {
       if (index && include_declaration) {
         auto symbols = index->lookup(symbol_name);
         if (!symbols.empty()) {
+          auto sym = index->symbol(symbols[0]);
           LocationInfo loc;
-          loc.uri = symbols[0]->file_uri;
-          loc.line = symbols[0]->line;
-          loc.column = symbols[0]->column;
+          loc.uri = sym.file_uri;
+          loc.line = sym.line;
+          loc.column = sym.column;
+          result.push_back(loc);
+        }
+      }
+
+      // Other uses of the name here are just as unresolved
+      for (const auto* other : active_sections()) {
+        for (const auto& occurrence :
+             other->parse->postings.unresolved(symbol_name)) {
+          LocationInfo loc;
+          loc.uri = m_uri;
+          loc.line = other->to_document(occurrence.line) - 1;
+          loc.column = occurrence.column - 1;
           result.push_back(loc);
         }
       }
     }
 
-    // TODO: For full cross-file references, we would need to scan all files
-    // in the workspace. For now, we only return references in the current file
-    // and the declaration from the index.
+    // Uses in other files come from the index, for globals and for names
+    // declared elsewhere; declaration sites are left to the code above
+    bool may_be_cross_file
+        = !target_decl || !target_decl->declaration
+          || target_decl->declaration->is_global();
+    if (index && may_be_cross_file && !symbol_name.empty()) {
+      auto declarations = index->lookup(symbol_name);
+      for (const auto* occurrences : index->lookup_occurrences(symbol_name)) {
+        if (cancel.cancelled()) {
+          break;
+        }
+        if (occurrences->file_uri == m_uri) {
+          continue;
+        }
+        for (const auto& pos : occurrences->positions) {
+          bool is_declaration
+              = std::ranges::any_of(declarations, [&](SymbolId id) {
+                  auto sym = index->symbol(id);
+                  return sym.file_uri == occurrences->file_uri
+                         && sym.line == pos.line && sym.column == pos.column;
+                });
+          if (is_declaration) {
+            continue;
+          }
+
+          LocationInfo loc;
+          loc.uri = occurrences->file_uri;
+          loc.line = pos.line;
+          loc.column = pos.column;
+          result.push_back(loc);
+        }
+      }
+    }
 
     return result;
   }
 
   auto Cpp2Document::get_completions(int line, int col,
-                                     const ProjectIndex* index) const
+                                     const ProjectIndex* index,
+                                     const CancellationToken& cancel) const
       -> std::vector<CompletionInfo> {
     std::vector<CompletionInfo> result;
 
@@ -348,23 +854,7 @@ namespace cpp2ls {
 
     // Check if we're completing a member access (obj. or obj:)
     // Look backwards in the current line for '.' or ':'
-    std::string line_text;
-    if (!m_content.empty()) {
-      // Extract current line (0-based)
-      size_t line_start = 0;
-      for (int i = 0; i < line; ++i) {
-        line_start = m_content.find('\n', line_start);
-        if (line_start == std::string::npos) break;
-        ++line_start;
-      }
-      if (line_start != std::string::npos) {
-        size_t line_end = m_content.find('\n', line_start);
-        if (line_end == std::string::npos) {
-          line_end = m_content.length();
-        }
-        line_text = m_content.substr(line_start, line_end - line_start);
-      }
-    }
+    std::string line_text{m_buffer.line(line)};
 
     // Check for member access pattern
     std::string object_name;
@@ -416,52 +906,15 @@ namespace cpp2ls {
     // If member completion, find the object's token and get its members
     if (is_member_completion && !object_name.empty()) {
       {  // Separate scope to avoid variable conflicts
-        // Use cached sema for member lookup
-        const cpp2::sema* sema_to_use = m_sema.get();
-        const cpp2::tokens* tokens_to_use = m_tokens.get();
-
-        if (m_cached_sema) {
-          bool current_empty = !sema_to_use || sema_to_use->symbols.empty();
-          bool cached_has_more
-              = m_cached_sema->symbols.size()
-                > (sema_to_use ? sema_to_use->symbols.size() : 0);
-          if (current_empty || (!m_valid && cached_has_more)) {
-            sema_to_use = m_cached_sema.get();
-            tokens_to_use = m_cached_tokens.get();  // Use matching tokens!
-          }
-        }
+        // Use the cached section for member lookup while editing
+        const auto* section = completion_section(target_line);
 
-        if (sema_to_use && tokens_to_use) {
-          // Find the token for the object identifier in the matching tokens
-          const cpp2::token* obj_token = nullptr;
-
-          // Search backwards from the cursor position
-          for (const auto& [lineno, section_tokens] :
-               tokens_to_use->get_map()) {
-            if (lineno > target_line) {
-              continue;
-            }
-
-            for (const auto& token : section_tokens) {
-              auto pos = token.position();
-
-              // Skip tokens at or after cursor position
-              if (lineno == target_line && pos.colno >= target_col) {
-                continue;
-              }
+        if (section) {
+          const cpp2::sema* sema_to_use = section->parse->sema.get();
 
-              // Check if this is an identifier token with matching name
-              if (token.type() == cpp2::lexeme::Identifier
-                  && token.to_string() == object_name) {
-                // Update best match if this is closer to cursor
-                if (!obj_token || pos.lineno > obj_token->position().lineno
-                    || (pos.lineno == obj_token->position().lineno
-                        && pos.colno > obj_token->position().colno)) {
-                  obj_token = &token;
-                }
-              }
-            }
-          }
+          // Find the token for the object identifier in the matching tokens
+          const cpp2::token* obj_token = find_identifier_token_before(
+              *section, object_name, target_line, target_col);
 
           std::cerr << std::format("  Looking for token '{}'\n", object_name);
           if (obj_token) {
@@ -475,117 +928,82 @@ namespace cpp2ls {
 
                 if (!type_name.empty()
                     && type_name.find("(*ERROR*)") == std::string::npos) {
-                  // Find the type declaration
-                  for (const auto& sym : sema_to_use->symbols) {
-                    if (!sym.is_declaration() || !sym.start) continue;
-
-                    const auto& type_sym = sym.as_declaration();
-                    if (!type_sym.declaration || !type_sym.identifier) continue;
-
-                    const auto* type_decl = type_sym.declaration;
-                    if (type_decl->is_type()
-                        && type_sym.identifier->to_string() == type_name) {
-                      // Found the type, now get its members
-                      for (const auto& member_sym : sema_to_use->symbols) {
-                        if (!member_sym.is_declaration() || !member_sym.start)
-                          continue;
-
-                        const auto& mem_decl_sym = member_sym.as_declaration();
-                        if (!mem_decl_sym.declaration
-                            || !mem_decl_sym.identifier)
-                          continue;
+                  // The type may live in another section than the object
+                  auto lookup_sections = active_sections();
+                  if (std::find(lookup_sections.begin(), lookup_sections.end(),
+                                section)
+                      == lookup_sections.end()) {
+                    lookup_sections.push_back(section);
+                  }
 
-                        const auto* mem_decl = mem_decl_sym.declaration;
-                        // Check if this declaration is a member of our type
-                        if (mem_decl->parent_declaration == type_decl) {
-                          auto member_name
-                              = mem_decl_sym.identifier->to_string();
-                          if (!member_name.empty()
-                              && !seen_names.contains(member_name)) {
-                            seen_names.insert(member_name);
-
-                            CompletionInfo info;
-                            info.label = member_name;
-
-                            if (mem_decl->is_function()) {
-                              info.kind = CompletionKind::Function;
-                              info.detail = mem_decl->signature_to_string();
-                              info.insert_text = member_name + "(";
-                            } else if (mem_decl->is_object()) {
-                              info.kind = CompletionKind::Variable;
-                              info.detail = mem_decl->object_type();
-                            }
-
-                            result.push_back(std::move(info));
-                          }
-                        }
+                  // Find the type declaration and add its members
+                  bool found_type = false;
+                  for (const auto* other : lookup_sections) {
+                    for (const auto* type_sym :
+                         other->parse->model.declarations_named(type_name)) {
+                      if (!type_sym->declaration->is_type()) {
+                        continue;
                       }
 
-                      // Add UFCS support: find global functions whose first
-                      // parameter type matches (but only for single '.' not
-                      // '..')
-                      if (!is_member_only) {
-                        // type_name already defined above
-                        for (const auto& func_sym : sema_to_use->symbols) {
-                          if (!func_sym.is_declaration() || !func_sym.start)
-                            continue;
-
-                          const auto& func_decl_sym = func_sym.as_declaration();
-                          if (!func_decl_sym.declaration
-                              || !func_decl_sym.identifier)
-                            continue;
-
-                          const auto* func_decl = func_decl_sym.declaration;
-                          // Only consider global functions (not members)
-                          if (func_decl->is_function()
-                              && !func_decl->parent_declaration) {
-                            // Safely access function parameters
-                            auto& func_type_variant = func_decl->type;
-                            if (func_type_variant.index()
-                                == cpp2::declaration_node::a_function) {
-                              auto* func_type
-                                  = std::get<
-                                        cpp2::declaration_node::a_function>(
-                                        func_type_variant)
-                                        .get();
-                              if (func_type && func_type->parameters
-                                  && func_type->parameters->ssize() > 0) {
-                                auto* first_param = (*func_type->parameters)[0];
-                                if (first_param && first_param->declaration
-                                    && first_param->declaration->is_object()) {
-                                  // Use safe object_type() method
-                                  std::string first_param_type
-                                      = first_param->declaration->object_type();
-
-                                  if (!first_param_type.empty()
-                                      && first_param_type.find("(*ERROR*)")
-                                             == std::string::npos
-                                      && first_param_type == type_name) {
-                                    auto func_name
-                                        = func_decl_sym.identifier->to_string();
-                                    if (!func_name.empty()
-                                        && !seen_names.contains(func_name)) {
-                                      seen_names.insert(func_name);
-
-                                      CompletionInfo info;
-                                      info.label = func_name;
-                                      info.kind = CompletionKind::Function;
-                                      info.detail
-                                          = func_decl->signature_to_string();
-                                      info.insert_text = func_name + "(";
-
-                                      result.push_back(std::move(info));
-                                    }
-                                  }
-                                }
-                              }
-                            }
-                          }
+                      for (const auto* mem_decl_sym :
+                           other->parse->model.members_of(
+                               type_sym->declaration)) {
+                        const auto* mem_decl = mem_decl_sym->declaration;
+                        auto member_name
+                            = mem_decl_sym->identifier->to_string();
+                        if (member_name.empty()
+                            || seen_names.contains(member_name)) {
+                          continue;
+                        }
+                        seen_names.insert(member_name);
+
+                        CompletionInfo info;
+                        info.label = member_name;
+
+                        if (mem_decl->is_function()) {
+                          info.kind = CompletionKind::Function;
+                          info.detail = mem_decl->signature_to_string();
+                          info.insert_text = member_name + "(";
+                        } else if (mem_decl->is_object()) {
+                          info.kind = CompletionKind::Variable;
+                          info.detail = mem_decl->object_type();
                         }
+
+                        result.push_back(std::move(info));
                       }
 
+                      found_type = true;
                       break;  // Found the type, done
                     }
+                    if (found_type) {
+                      break;
+                    }
+                  }
+
+                  // Add UFCS support: free functions whose first parameter
+                  // type matches (but only for single '.' not '..')
+                  if (found_type && !is_member_only) {
+                    for (const auto* other : lookup_sections) {
+                      for (const auto* func_decl_sym :
+                           other->parse->model.ufcs_candidates(type_name)) {
+                        auto func_name
+                            = func_decl_sym->identifier->to_string();
+                        if (func_name.empty()
+                            || seen_names.contains(func_name)) {
+                          continue;
+                        }
+                        seen_names.insert(func_name);
+
+                        CompletionInfo info;
+                        info.label = func_name;
+                        info.kind = CompletionKind::Function;
+                        info.detail = func_decl_sym->declaration
+                                          ->signature_to_string();
+                        info.insert_text = func_name + "(";
+
+                        result.push_back(std::move(info));
+                      }
+                    }
                   }
                 }
               }
@@ -600,107 +1018,31 @@ namespace cpp2ls {
 
     // Regular completion (non-member)
 
-    // Use cached sema if:
-    // 1. Current sema is null or empty, OR
-    // 2. There are parse errors (m_valid is false) and cached sema has more
-    // symbols
-    const cpp2::sema* sema_to_use = m_sema.get();
-    if (m_cached_sema) {
-      bool current_empty = !sema_to_use || sema_to_use->symbols.empty();
-      bool cached_has_more = m_cached_sema->symbols.size()
-                             > (sema_to_use ? sema_to_use->symbols.size() : 0);
-      if (current_empty || (!m_valid && cached_has_more)) {
-        sema_to_use = m_cached_sema.get();
-      }
-    }
-
-    // Track which function contains the cursor
-    const cpp2::declaration_node* containing_function = nullptr;
-
-    if (sema_to_use) {
-      // Find the innermost function containing the cursor by checking depth
-      // We iterate through all function declarations and find the one that:
-      // 1. Starts before the cursor
-      // 2. Has the highest depth (innermost)
-      // 3. The cursor is within its scope
-
-      // First, collect all symbols with their positions to understand scope
-      // boundaries
-      struct FunctionScope {
-        const cpp2::declaration_node* decl;
-        int start_line;
-        int end_line;  // Line of closing brace (0 if unknown)
-        int depth;
-      };
-      std::vector<FunctionScope> function_scopes;
-
-      for (const auto& sym : sema_to_use->symbols) {
-        if (!sym.is_declaration() || !sym.start) {
-          continue;
-        }
-
-        const auto& decl_sym = sym.as_declaration();
-        if (!decl_sym.declaration) {
-          continue;
-        }
-
-        const auto* decl = decl_sym.declaration;
-        if (decl->is_function()) {
-          auto pos = decl_sym.position();
-          int end_line = 0;
-
-          // Get the closing brace position from the function body
-          if (decl->initializer) {
-            if (auto* compound
-                = decl->initializer->get_if<cpp2::compound_statement_node>()) {
-              end_line = compound->close_brace.lineno;
-            }
-          }
-
-          function_scopes.push_back({decl, pos.lineno, end_line, sym.depth});
-        }
-      }
-
-      // Find the function that contains our cursor
-      // A function contains the cursor if:
-      // - The function starts before the cursor line
-      // - The cursor is before the function's closing brace
-      for (const auto& fs : function_scopes) {
-        if (fs.start_line > target_line) {
-          continue;  // Function starts after cursor
-        }
-
-        // Check if cursor is within this function's scope
-        // If we have a valid end_line (close_brace), use it
-        if (fs.end_line > 0 && target_line > fs.end_line) {
-          continue;  // Cursor is after the closing brace
+    // Use the cached section while the current one is broken; globals from
+    // other sections come in through the index below
+    const auto* section = completion_section(target_line);
+
+    if (section && section->parse->sema) {
+      // Visible declarations are those of the scopes enclosing the cursor,
+      // innermost first, up to the file scope
+      const auto& scopes = section->parse->scopes;
+      SourcePosition cursor{section->to_section(target_line), target_col};
+      std::vector<const ScopeTree::Declaration*> candidates;
+      for (auto scope = scopes.innermost(cursor);;
+           scope = scopes.parent(scope)) {
+        for (const auto& declaration : scopes.declarations_in(scope)) {
+          candidates.push_back(&declaration);
         }
-
-        // For nested functions, prefer the innermost one (highest depth)
-        if (containing_function == nullptr) {
-          containing_function = fs.decl;
-        } else {
-          // Check if this function is nested inside the current one
-          // by comparing depths and positions
-          if (fs.depth > 0
-              && fs.start_line > containing_function->position().lineno) {
-            containing_function = fs.decl;
-          }
+        if (scope == ScopeTree::kFileScope) {
+          break;
         }
       }
 
-      // Collect visible symbols
-      for (const auto& sym : sema_to_use->symbols) {
-        if (!sym.is_declaration() || !sym.start) {
-          continue;
-        }
+      // Offer them in declaration order, like sema lists them
+      std::ranges::sort(candidates, {}, &ScopeTree::Declaration::order);
 
-        const auto& decl_sym = sym.as_declaration();
-        if (!decl_sym.declaration || !decl_sym.identifier) {
-          continue;
-        }
-
-        auto decl_pos = decl_sym.position();
+      for (const auto* candidate : candidates) {
+        const auto& decl_sym = *candidate->sym;
         const auto* decl = decl_sym.declaration;
         auto name = decl_sym.identifier->to_string();
 
@@ -708,37 +1050,10 @@ namespace cpp2ls {
           continue;
         }
 
-        bool is_visible = false;
-
-        // Global functions, types, namespaces are always visible (cpp2
-        // supports forward references)
-        if (decl->is_function() || decl->is_type() || decl->is_namespace()) {
-          if (decl->is_global()) {
-            is_visible = true;
-          }
-        } else if (decl->is_object()) {
-          // For variables/parameters, they must be declared before cursor
-          if (decl_pos.lineno > target_line) {
-            continue;
-          }
-          // Check if they're in scope
-          if (containing_function == nullptr) {
-            // At global scope - only global variables are visible
-            is_visible = decl->is_global();
-          } else {
-            // Inside a function - check if variable belongs to our function
-            auto* var_parent = decl->parent_declaration;
-            while (var_parent) {
-              if (var_parent == containing_function) {
-                is_visible = true;
-                break;
-              }
-              var_parent = var_parent->parent_declaration;
-            }
-          }
-        }
-
-        if (!is_visible) {
+        // Functions, types and namespaces are visible throughout their scope
+        // (cpp2 supports forward references); variables and parameters only
+        // after their declaration
+        if (decl->is_object() && !(candidate->position < cursor)) {
           continue;
         }
 
@@ -775,20 +1090,24 @@ namespace cpp2ls {
 
     // Add symbols from global index (cross-file completion)
     if (index) {
-      for (const auto* sym : index->all_symbols()) {
-        if (!sym || seen_names.contains(sym->name)) {
+      for (auto id : index->all_symbols()) {
+        if (cancel.cancelled()) {
+          break;
+        }
+        auto sym = index->symbol(id);
+        auto [it, inserted] = seen_names.emplace(sym.name);
+        if (!inserted) {
           continue;
         }
-        seen_names.insert(sym->name);
 
         CompletionInfo info;
-        info.label = sym->name;
+        info.label = sym.name;
 
-        switch (sym->kind) {
+        switch (sym.kind) {
           case SymbolKind::Function:
             info.kind = CompletionKind::Function;
-            info.detail = sym->signature;
-            info.insert_text = sym->name + "(";
+            info.detail = sym.signature;
+            info.insert_text = std::string(sym.name) + "(";
             break;
           case SymbolKind::Type:
             info.kind = CompletionKind::Type;
@@ -867,25 +1186,17 @@ namespace cpp2ls {
   auto Cpp2Document::get_signature_help(int line, int col,
                                         const ProjectIndex* index) const
       -> std::optional<SignatureHelpInfo> {
-    // Use cached sema if current is null or has errors
-    const cpp2::sema* sema_to_use = m_sema.get();
-    if (m_cached_sema) {
-      bool current_empty = !sema_to_use || sema_to_use->symbols.empty();
-      bool cached_has_more = m_cached_sema->symbols.size()
-                             > (sema_to_use ? sema_to_use->symbols.size() : 0);
-      if (current_empty || (!m_valid && cached_has_more)) {
-        sema_to_use = m_cached_sema.get();
-      }
-    }
-
-    if (!sema_to_use) {
-      return std::nullopt;
-    }
-
     // Convert to 1-based for cppfront
     int target_line = line + 1;
     int target_col = col + 1;
 
+    // Use cached sema if current is null or has errors
+    const auto* section = completion_section(target_line);
+    if (!section) {
+      return std::nullopt;
+    }
+    const cpp2::sema* sema_to_use = section->parse->sema.get();
+
     // Strategy: Look backwards from cursor to find function call
     // We're looking for a pattern like: function_name( ... cursor is here
     // We need to:
@@ -894,60 +1205,48 @@ namespace cpp2ls {
     // 3. Count commas to determine active parameter
 
     // Scan backwards through tokens to find function call context
-    const cpp2::tokens* tokens_to_use
-        = m_tokens ? m_tokens.get() : m_cached_tokens.get();
-    if (!tokens_to_use) {
+    const auto* token_section = active_section(target_line);
+    if (!token_section) {
       return std::nullopt;
     }
+    const auto& token_table = token_section->parse->token_table;
+    const auto& entries = token_table.entries();
 
-    // Find tokens before cursor
+    // Walk back from the cursor to the innermost unclosed '(' of the current
+    // statement, counting the commas at its depth along the way
     const cpp2::token* function_name_token = nullptr;
     int paren_depth = 0;
     int active_param = 0;
-    bool found_open_paren = false;
-
-    // Scan tokens up to cursor position
-    for (const auto& [lineno, section_tokens] : tokens_to_use->get_map()) {
-      for (const auto& token : section_tokens) {
-        auto pos = token.position();
-
-        // Skip tokens after cursor
-        if (pos.lineno > target_line
-            || (pos.lineno == target_line && pos.colno >= target_col)) {
-          break;
-        }
-
-        auto token_str = token.to_string();
 
-        // Track parentheses depth
-        if (token_str == "(") {
-          paren_depth++;
-          if (paren_depth == 1 && !found_open_paren) {
-            // This is the opening paren of the function call we're in
-            found_open_paren = true;
-            active_param = 0;
+    for (auto index = token_table.lower_bound(
+             token_section->to_section(target_line), target_col);
+         index > 0; --index) {
+      const auto& entry = entries[index - 1];
+
+      if (entry.text == ")") {
+        paren_depth++;
+      } else if (entry.text == "(") {
+        if (paren_depth == 0) {
+          // This is the opening paren of the call we're in; the function
+          // name is the identifier right before it
+          if (index >= 2 && entries[index - 2].is_identifier) {
+            function_name_token = entries[index - 2].token;
           }
-        } else if (token_str == ")") {
-          paren_depth--;
-          if (paren_depth == 0) {
-            // We exited the function call, reset
-            found_open_paren = false;
-            function_name_token = nullptr;
-            active_param = 0;
-          }
-        } else if (token_str == "," && paren_depth == 1 && found_open_paren) {
-          // Count commas at depth 1 to track active parameter
-          active_param++;
-        } else if (paren_depth == 0
-                   && token.type() == cpp2::lexeme::Identifier) {
-          // Potential function name before '('
-          function_name_token = &token;
+          break;
         }
+        paren_depth--;
+      } else if (entry.text == "," && paren_depth == 0) {
+        active_param++;
+      } else if (paren_depth == 0
+                 && (entry.text == ";" || entry.text == "{"
+                     || entry.text == "}")) {
+        // Reached the start of the statement without finding a call
+        break;
       }
     }
 
     // If we're not inside a function call, no signature help
-    if (!found_open_paren || !function_name_token || paren_depth != 1) {
+    if (!function_name_token) {
       return std::nullopt;
     }
 
@@ -957,23 +1256,21 @@ namespace cpp2ls {
     auto decl_info = sema_to_use->get_declaration_of(function_name_token, true);
     if (!decl_info || !decl_info->declaration
         || !decl_info->declaration->is_function()) {
-      // Try to find function in sema symbols by name
-      if (sema_to_use) {
-        for (size_t i = 0; i < sema_to_use->symbols.size(); ++i) {
-          const auto& sym = sema_to_use->symbols[i];
-          if (sym.is_declaration()) {
-            const auto& decl_sym = std::get<cpp2::declaration_sym>(sym.sym);
-            if (decl_sym.declaration && decl_sym.declaration->has_name()
-                && decl_sym.declaration->name()->to_string() == func_name
-                && decl_sym.declaration->is_function()) {
-              SignatureHelpInfo help;
-              SignatureInfo sig;
-              sig.label = decl_sym.declaration->signature_to_string();
-              sig.active_parameter = active_param;
-              help.signatures.push_back(std::move(sig));
-              help.active_signature = 0;
-              return help;
-            }
+      // Try to find function in sema symbols by name, starting with the
+      // cursor's section
+      auto lookup_sections = active_sections();
+      lookup_sections.insert(lookup_sections.begin(), section);
+      for (const auto* other : lookup_sections) {
+        for (const auto* decl_sym :
+             other->parse->model.declarations_named(func_name)) {
+          if (decl_sym->declaration->is_function()) {
+            SignatureHelpInfo help;
+            SignatureInfo sig;
+            sig.label = decl_sym->declaration->signature_to_string();
+            sig.active_parameter = active_param;
+            help.signatures.push_back(std::move(sig));
+            help.active_signature = 0;
+            return help;
           }
         }
       }
@@ -981,11 +1278,12 @@ namespace cpp2ls {
       // Try index for cross-file functions
       if (index) {
         auto symbols = index->lookup(function_name_token->to_string());
-        if (!symbols.empty() && symbols[0]->kind == SymbolKind::Function) {
+        if (!symbols.empty()
+            && index->symbol(symbols[0]).kind == SymbolKind::Function) {
+          auto sym = index->symbol(symbols[0]);
           SignatureHelpInfo help;
           SignatureInfo sig;
-          sig.label = symbols[0]->signature.empty() ? symbols[0]->name
-                                                    : symbols[0]->signature;
+          sig.label = sym.signature.empty() ? sym.name : sym.signature;
           sig.active_parameter = active_param;
           // TODO: Parse parameters from signature
           help.signatures.push_back(std::move(sig));
@@ -1016,89 +1314,48 @@ namespace cpp2ls {
 
   auto Cpp2Document::diagnostics() const -> std::vector<DiagnosticInfo> {
     std::vector<DiagnosticInfo> result;
-    if (!m_errors) {
+    if (!m_parse) {
       return result;
     }
-    for (const auto& error : *m_errors) {
-      if (error.fallback && m_errors->size() > 1) {
+    // Errors with the section they came from, null for the file's own
+    std::vector<std::pair<const cpp2::error_entry*, const PlacedSection*>>
+        errors;
+    for (const auto& error : m_parse->errors) {
+      errors.emplace_back(&error, nullptr);
+    }
+    for (const auto& section : m_parse->sections) {
+      for (const auto& error : section.parse->errors) {
+        errors.emplace_back(&error, &section);
+      }
+    }
+
+    for (const auto& [error, section] : errors) {
+      if (error->fallback && errors.size() > 1) {
         continue;
       }
+      auto lineno = section ? section->to_document(error->where.lineno)
+                            : error->where.lineno;
       DiagnosticInfo info;
-      info.line = std::max(0, error.where.lineno - 1);
-      info.column = std::max(0, error.where.colno - 1);
-      info.message = error.msg;
-      info.is_internal = error.internal;
+      info.line = std::max(0, lineno - 1);
+      info.column = std::max(0, error->where.colno - 1);
+      info.message = error->msg;
+      info.is_internal = error->internal;
       result.push_back(std::move(info));
     }
     return result;
   }
 
-  auto Cpp2Document::find_token_at(int line, int col) const
-      -> const cpp2::token* {
-    // Use cached tokens if current is null
-    const cpp2::tokens* tokens_to_use
-        = m_tokens ? m_tokens.get() : m_cached_tokens.get();
-
-    if (!tokens_to_use) {
-      return nullptr;
-    }
-
-    for (const auto& [lineno, section_tokens] : tokens_to_use->get_map()) {
-      for (const auto& token : section_tokens) {
-        auto pos = token.position();
-
-        if (pos.lineno == line && col >= pos.colno
-            && col < pos.colno + token.length()) {
-          return &token;
-        }
-      }
-    }
-
-    return nullptr;
+  auto Cpp2Document::find_token_at(const PlacedSection& section, int line,
+                                   int col) const -> const cpp2::token* {
+    return section.parse->token_table.at(section.to_section(line), col);
   }
 
-  auto Cpp2Document::find_identifier_token_before(const std::string& name,
+  auto Cpp2Document::find_identifier_token_before(const PlacedSection& section,
+                                                  const std::string& name,
                                                   int line, int col) const
       -> const cpp2::token* {
-    // Use cached tokens if current is null
-    const cpp2::tokens* tokens_to_use
-        = m_tokens ? m_tokens.get() : m_cached_tokens.get();
-
-    if (!tokens_to_use) {
-      return nullptr;
-    }
-
-    const cpp2::token* best_match = nullptr;
-
-    // Search backwards from the cursor position
-    for (const auto& [lineno, section_tokens] : tokens_to_use->get_map()) {
-      // Skip lines after the cursor
-      if (lineno > line) {
-        continue;
-      }
-
-      for (const auto& token : section_tokens) {
-        auto pos = token.position();
-
-        // Skip tokens at or after cursor position
-        if (lineno == line && pos.colno >= col) {
-          continue;
-        }
-
-        // Check if this is an identifier token with matching name
-        if (token.type() == cpp2::lexeme::Identifier
-            && token.to_string() == name) {
-          // Update best match if this is closer to cursor
-          if (!best_match || pos.lineno > best_match->position().lineno
-              || (pos.lineno == best_match->position().lineno
-                  && pos.colno > best_match->position().colno)) {
-            best_match = &token;
-          }
-        }
-      }
-    }
-
-    return best_match;
+    return section.parse->token_table.identifier_before(
+        name, section.to_section(line), col);
   }
 
   auto Cpp2Document::build_hover_content(const cpp2::declaration_sym& sym) const
@@ -1154,7 +1411,7 @@ namespace cpp2ls {
     return oss.str();
   }
 
-  auto Cpp2Document::build_hover_content(const IndexedSymbol& sym) const
+  auto Cpp2Document::build_hover_content(const SymbolView& sym) const
       -> std::string {
     std::ostringstream oss;
     oss << "```cpp2\n";
@@ -1194,54 +1451,82 @@ namespace cpp2ls {
   auto Cpp2Document::get_indexed_symbols() const -> std::vector<IndexedSymbol> {
     std::vector<IndexedSymbol> result;
 
-    // Use cached parser/tokens if current is null
-    const cpp2::parser* parser_to_use
-        = m_parser ? m_parser.get() : m_cached_parser.get();
-    const cpp2::tokens* tokens_to_use
-        = m_tokens ? m_tokens.get() : m_cached_tokens.get();
+    // Use cached sections where the current ones didn't get to sema
+    for (const auto* section : active_sections()) {
+      const auto& parse = *section->parse;
+      for (const auto& [lineno, section_tokens] : parse.tokens->get_map()) {
+        if (section_tokens.empty()) {
+          continue;
+        }
 
-    if (!parser_to_use || !tokens_to_use) {
-      return result;
-    }
+        auto declarations
+            = parse.parser->get_parse_tree_declarations_in_range(
+                section_tokens);
+        for (const auto* decl : declarations) {
+          if (!decl || !decl->has_name()) {
+            continue;
+          }
 
-    for (const auto& [lineno, section_tokens] : tokens_to_use->get_map()) {
-      if (section_tokens.empty()) {
-        continue;
-      }
+          if (!decl->is_global()) {
+            continue;
+          }
 
-      auto declarations
-          = parser_to_use->get_parse_tree_declarations_in_range(section_tokens);
-      for (const auto* decl : declarations) {
-        if (!decl || !decl->has_name()) {
-          continue;
+          IndexedSymbol sym;
+          sym.name = decl->name()->to_string();
+          auto pos = decl->position();
+          sym.line = section->to_document(pos.lineno) - 1;
+          sym.column = pos.colno - 1;
+
+          if (decl->is_function()) {
+            sym.kind = SymbolKind::Function;
+            sym.signature = decl->signature_to_string();
+          } else if (decl->is_type()) {
+            sym.kind = SymbolKind::Type;
+          } else if (decl->is_namespace()) {
+            sym.kind = SymbolKind::Namespace;
+          } else if (decl->is_object()) {
+            sym.kind = SymbolKind::Variable;
+          } else if (decl->is_alias()) {
+            sym.kind = SymbolKind::Alias;
+          } else {
+            continue;
+          }
+
+          result.push_back(std::move(sym));
         }
+      }
+    }
 
-        if (!decl->is_global()) {
+    return result;
+  }
+
+  auto Cpp2Document::get_indexed_occurrences() const
+      -> std::vector<IndexedOccurrences> {
+    std::vector<IndexedOccurrences> result;
+    std::unordered_map<std::string_view, std::size_t> by_name;
+
+    for (const auto* section : active_sections()) {
+      for (const auto& entry : section->parse->token_table.entries()) {
+        if (!entry.is_identifier) {
           continue;
         }
 
-        IndexedSymbol sym;
-        sym.name = decl->name()->to_string();
-        auto pos = decl->position();
-        sym.line = pos.lineno - 1;
-        sym.column = pos.colno - 1;
-
-        if (decl->is_function()) {
-          sym.kind = SymbolKind::Function;
-          sym.signature = decl->signature_to_string();
-        } else if (decl->is_type()) {
-          sym.kind = SymbolKind::Type;
-        } else if (decl->is_namespace()) {
-          sym.kind = SymbolKind::Namespace;
-        } else if (decl->is_object()) {
-          sym.kind = SymbolKind::Variable;
-        } else if (decl->is_alias()) {
-          sym.kind = SymbolKind::Alias;
-        } else {
+        // Locals and members can't be named from another file; unresolved
+        // identifiers may refer to declarations elsewhere
+        const auto* decl_sym
+            = section->parse->sema->get_declaration_of(entry.token, true);
+        if (decl_sym
+            && (!decl_sym->declaration
+                || !decl_sym->declaration->is_global())) {
           continue;
         }
 
-        result.push_back(std::move(sym));
+        auto [it, inserted] = by_name.try_emplace(entry.text, result.size());
+        if (inserted) {
+          result.push_back({std::string(entry.text), m_uri, {}});
+        }
+        result[it->second].positions.push_back(
+            {section->to_document(entry.line) - 1, entry.column - 1});
       }
     }
 
@@ -1,23 +1,38 @@
 #ifndef CPP2LS_DOCUMENT_H
 #define CPP2LS_DOCUMENT_H
 
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "cancellation.h"
+#include "document_model.h"
 #include "index.h"
+#include "position_encoding.h"
+#include "reference_postings.h"
+#include "scope_tree.h"
+#include "text_buffer.h"
+#include "token_table.h"
 
 // Forward declarations from cppfront
 namespace cpp2 {
-  class source;
+  struct source_line;
   class tokens;
   class parser;
   class sema;
   struct token;
   struct error_entry;
   struct declaration_sym;
+  struct generated_storage;
 }  // namespace cpp2
 
 namespace cpp2ls {
@@ -84,21 +99,155 @@ namespace cpp2ls {
     int active_signature{0};  // Which signature to highlight (for overloads)
   };
 
+  /// Lexed, parsed and analyzed form of one Cpp2 section of a document
+  ///
+  /// Sections are the runs of Cpp2 lines that cppfront lexes as a unit (the
+  /// entries of tokens::get_map()). Each one gets its own cppfront pipeline,
+  /// so an edit only re-runs lex/parse/sema for the section it touched while
+  /// unchanged sections are carried over from the previous parse.
+  ///
+  /// All positions inside are relative to the section: line 1 is its first
+  /// line. That keeps a section valid when edits above it move it, so only
+  /// its PlacedSection changes. Sema sees one section at a time, so a name
+  /// used in one section but declared in another stays unresolved here.
+  struct SectionParse {
+    SectionParse();
+    ~SectionParse();
+
+    SectionParse(const SectionParse&) = delete;
+    SectionParse& operator=(const SectionParse&) = delete;
+
+    std::uint64_t hash{0};  // Hash of the section's line texts
+
+    // The cppfront components below hold references to these
+    std::vector<cpp2::error_entry> errors;
+    std::vector<cpp2::source_line> lines;
+    std::set<std::string> includes;
+    std::unique_ptr<cpp2::generated_storage> generated;  // Text cppfront made
+    std::unique_ptr<cpp2::tokens> tokens;
+    TokenTable token_table;  // Position-sorted index over `tokens`
+    std::unique_ptr<cpp2::parser> parser;
+    std::unique_ptr<cpp2::sema> sema;
+    DocumentModel model;         // Lookup tables over `sema`
+    ScopeTree scopes;            // Scope nesting from `sema`
+    ReferencePostings postings;  // Uses of each declaration in `sema`
+    bool valid{false};
+  };
+
+  /// A section at the lines it occupies in one parse's text
+  struct PlacedSection {
+    /// Convert a 1-based document line to a line of the section
+    auto to_section(int line) const -> int { return line - first_line + 1; }
+
+    /// Convert a 1-based line of the section to a document line
+    auto to_document(int line) const -> int { return line + first_line - 1; }
+
+    std::shared_ptr<const SectionParse> parse;  // Never null
+    int first_line{1};                          // 1-based, inclusive
+    int last_line{0};                           // 1-based, inclusive
+  };
+
+  /// Output of one cppfront run over a document's text
+  ///
+  /// A result is immutable once built, so it can be produced off the main
+  /// thread and keep serving queries while a newer parse is in flight.
+  struct ParseResult {
+    ParseResult();
+    ~ParseResult();
+
+    ParseResult(const ParseResult&) = delete;
+    ParseResult& operator=(const ParseResult&) = delete;
+
+    /// Find the section nearest to `line` (1-based): the one containing it,
+    /// else the closest one above it, else the first one
+    auto section_at(int line) const -> const PlacedSection*;
+
+    // Sections in line order
+    std::vector<PlacedSection> sections;
+
+    // Errors from splitting the file into lines and sections
+    std::vector<cpp2::error_entry> errors;
+    bool valid{false};
+
+    // content_hash() and size of the parsed text
+    std::uint64_t content_hash{0};
+    std::size_t content_size{0};
+  };
+
   /// Manages parsing and semantic analysis for a single cpp2 document
   class Cpp2Document {
   public:
     explicit Cpp2Document(std::string uri);
-    ~Cpp2Document();
 
     // Non-copyable, movable
     Cpp2Document(const Cpp2Document&) = delete;
     Cpp2Document& operator=(const Cpp2Document&) = delete;
-    Cpp2Document(Cpp2Document&&) noexcept;
-    Cpp2Document& operator=(Cpp2Document&&) noexcept;
+    Cpp2Document(Cpp2Document&&) noexcept = default;
+    Cpp2Document& operator=(Cpp2Document&&) noexcept = default;
 
     /// Update the document content and re-parse
     void update(const std::string& content);
 
+    /// Replace the whole document content without re-parsing
+    void set_text(std::string content);
+
+    /// Replace the given 0-based range with `text` without re-parsing
+    /// Used for incremental sync; call reparse() once all edits are applied
+    void apply_edit(int start_line, int start_col, int end_line, int end_col,
+                    std::string_view text);
+
+    /// Re-parse the current document content
+    void reparse();
+
+    /// Run cppfront over `text`
+    /// Sections whose text is unchanged since `previous`, wherever they
+    /// moved to, are reused from it instead of being parsed again. Touches no
+    /// document state, so it may run on a background thread.
+    /// Returns null if `cancel` is cancelled before the parse completes;
+    /// cppfront checks it every few hundred lines, tokens or declarations.
+    static auto parse(std::string_view text,
+                      const ParseResult* previous = nullptr,
+                      const CancellationToken& cancel = {})
+        -> std::shared_ptr<const ParseResult>;
+
+    /// Latest installed parse, if any
+    auto parse_result() const -> std::shared_ptr<const ParseResult>;
+
+    /// Immutable copy of the document, sharing its parse results
+    /// The copy may be queried from several threads at once
+    auto snapshot() const -> std::shared_ptr<const Cpp2Document>;
+
+    /// Make `result`, parsed from the text at `revision`, the latest parse
+    /// Successful parses are also kept as the fallback used while editing
+    void install(std::shared_ptr<const ParseResult> result,
+                 std::uint64_t revision);
+
+    /// Get the current document text
+    auto text() const -> std::string_view;
+
+    /// Size of the current document text in bytes; cheaper than text()
+    auto size() const -> std::size_t;
+
+    /// Get the text of a 0-based line, without its line terminator
+    auto line(int line) const -> std::string_view;
+
+    /// Line start offsets of the current text
+    auto lines() const -> const LineIndex&;
+
+    /// Convert a column on a 0-based line from `encoding` to bytes
+    auto to_byte_column(int line, int col, PositionEncoding encoding) const
+        -> int;
+
+    /// Convert a byte column on a 0-based line to `encoding`
+    auto from_byte_column(int line, int byte_col,
+                          PositionEncoding encoding) const -> int;
+
+    /// Edit counter, bumped on every text change
+    auto revision() const -> std::uint64_t;
+
+    /// Revision of the text the latest installed parse was built from
+    auto parsed_revision() const -> std::uint64_t;
+
     /// Get hover information at the given position (0-based line and column)
     /// Uses global index for cross-file symbol lookup
     auto get_hover_info(int line, int col, const ProjectIndex* index) const
@@ -113,13 +262,17 @@ namespace cpp2ls {
     /// Get all references to the symbol at the given position (0-based)
     /// Uses global index for cross-file references
     /// If include_declaration is true, the declaration itself is included
+    /// Stops early, with partial results, once `cancel` is cancelled
     auto get_references(int line, int col, bool include_declaration,
-                        const ProjectIndex* index) const
+                        const ProjectIndex* index,
+                        const CancellationToken& cancel = {}) const
         -> std::vector<LocationInfo>;
 
     /// Get completion items at the given position (0-based line and column)
     /// Uses global index for cross-file symbol completion
-    auto get_completions(int line, int col, const ProjectIndex* index) const
+    /// Stops early, with partial results, once `cancel` is cancelled
+    auto get_completions(int line, int col, const ProjectIndex* index,
+                         const CancellationToken& cancel = {}) const
         -> std::vector<CompletionInfo>;
 
     /// Get signature help at the given position (0-based line and column)
@@ -130,6 +283,14 @@ namespace cpp2ls {
     /// Get indexed symbols for this document (for project-wide indexing)
     auto get_indexed_symbols() const -> std::vector<IndexedSymbol>;
 
+    /// Get the identifiers this document uses that may refer to other files
+    /// (for project-wide find-references)
+    auto get_indexed_occurrences() const -> std::vector<IndexedOccurrences>;
+
+    /// Get the files named by the document's `#include "..."` lines,
+    /// resolved against the document's directory
+    auto included_files() const -> std::vector<std::filesystem::path>;
+
     /// Get the document URI
     auto uri() const -> const std::string&;
 
@@ -140,37 +301,72 @@ namespace cpp2ls {
     auto diagnostics() const -> std::vector<DiagnosticInfo>;
 
   private:
-    /// Find the token at the given position (1-based line and column)
-    auto find_token_at(int line, int col) const -> const cpp2::token*;
+    /// The section to answer queries at `line` (1-based) from: the latest
+    /// parse's section when it got as far as sema, otherwise the section at
+    /// that line in the last successful parse
+    auto active_section(int line) const -> const PlacedSection*;
+
+    /// Like active_section, but also falls back to the last successful parse
+    /// when the latest one is broken and knows fewer symbols there
+    auto completion_section(int line) const -> const PlacedSection*;
+
+    /// All sections to search for file-wide declarations, each taken from
+    /// the latest parse or, where that one has no sema, the cached parse
+    auto active_sections() const -> std::vector<const PlacedSection*>;
+
+    /// Find a global declaration of `name` in any section but `except`
+    /// Stands in for the cross-section lookup sema doesn't do
+    auto find_global_declaration(const std::string& name,
+                                 const PlacedSection* except) const
+        -> std::pair<const PlacedSection*, const cpp2::declaration_sym*>;
+
+    /// Find the token at the given position (1-based document line and
+    /// column)
+    auto find_token_at(const PlacedSection& section, int line, int col) const
+        -> const cpp2::token*;
 
     /// Find the nearest identifier token with given name before the position
-    /// (1-based line and column)
-    auto find_identifier_token_before(const std::string& name, int line,
+    /// (1-based document line and column)
+    auto find_identifier_token_before(const PlacedSection& section,
+                                      const std::string& name, int line,
                                       int col) const -> const cpp2::token*;
 
+    /// Column conversion table for a 0-based line, built on first use
+    auto column_map(int line) const -> const ColumnMap&;
+
     /// Build hover content for a declaration
     auto build_hover_content(const cpp2::declaration_sym& sym) const
         -> std::string;
 
     /// Build hover content for an indexed symbol
-    auto build_hover_content(const IndexedSymbol& sym) const -> std::string;
+    auto build_hover_content(const SymbolView& sym) const -> std::string;
 
     std::string m_uri;
-    std::string m_content;
-
-    // Cppfront parsing state
-    std::vector<cpp2::error_entry>* m_errors{nullptr};
-    std::unique_ptr<cpp2::source> m_source;
-    std::unique_ptr<cpp2::tokens> m_tokens;
-    std::unique_ptr<cpp2::parser> m_parser;
-    std::unique_ptr<cpp2::sema> m_sema;
-    bool m_valid{false};
-
-    // Cached state from last successful parse (for completion during editing)
-    std::unique_ptr<cpp2::source> m_cached_source;
-    std::unique_ptr<cpp2::tokens> m_cached_tokens;
-    std::unique_ptr<cpp2::parser> m_cached_parser;
-    std::unique_ptr<cpp2::sema> m_cached_sema;
+    TextBuffer m_buffer;
+    std::uint64_t m_revision{0};
+    std::uint64_t m_parsed_revision{0};
+
+    // Column tables of the lines positions were converted on, by line
+    // column_map() locks them, as a snapshot is queried from several
+    // threads at once; edits only happen to documents nobody else reads
+    struct ColumnMaps {
+      ColumnMaps() = default;
+      ColumnMaps(ColumnMaps&& other) noexcept : maps{std::move(other.maps)} {}
+      auto operator=(ColumnMaps&& other) noexcept -> ColumnMaps& {
+        maps = std::move(other.maps);
+        return *this;
+      }
+
+      std::mutex mutex;
+      std::unordered_map<int, ColumnMap> maps;
+    };
+    mutable ColumnMaps m_column_maps;
+
+    // Latest parse, whether or not it succeeded
+    std::shared_ptr<const ParseResult> m_parse;
+
+    // Last successful parse (for completion during editing)
+    std::shared_ptr<const ParseResult> m_cached;
   };
 
 }  // namespace cpp2ls
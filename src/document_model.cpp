@@ -0,0 +1,46 @@
+#include "document_model.h"
+
+namespace cpp2ls {
+
+  namespace {
+    auto find_in(const auto& map, const auto& key)
+        -> DocumentModel::Declarations {
+      auto it = map.find(key);
+      if (it == map.end()) {
+        return {};
+      }
+      return it->second;
+    }
+  }  // namespace
+
+  void DocumentModel::add_declaration(std::string name,
+                                      const cpp2::declaration_sym* sym) {
+    m_by_name[std::move(name)].push_back(sym);
+  }
+
+  void DocumentModel::add_member(const cpp2::declaration_node* type,
+                                 const cpp2::declaration_sym* member) {
+    m_members[type].push_back(member);
+  }
+
+  void DocumentModel::add_ufcs_candidate(
+      std::string type_name, const cpp2::declaration_sym* function) {
+    m_ufcs_by_type[std::move(type_name)].push_back(function);
+  }
+
+  auto DocumentModel::declarations_named(std::string_view name) const
+      -> Declarations {
+    return find_in(m_by_name, name);
+  }
+
+  auto DocumentModel::members_of(const cpp2::declaration_node* type) const
+      -> Declarations {
+    return find_in(m_members, type);
+  }
+
+  auto DocumentModel::ufcs_candidates(std::string_view type_name) const
+      -> Declarations {
+    return find_in(m_ufcs_by_type, type_name);
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,64 @@
+#ifndef CPP2LS_DOCUMENT_MODEL_H
+#define CPP2LS_DOCUMENT_MODEL_H
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "string_hash.h"
+
+// Forward declarations from cppfront
+namespace cpp2 {
+  struct declaration_node;
+  struct declaration_sym;
+}  // namespace cpp2
+
+namespace cpp2ls {
+
+  /// Lookup tables derived from one section's semantic analysis
+  ///
+  /// sema only offers its symbols as a flat list, so answering "which type
+  /// is called T", "what are T's members" or "which free functions take a T
+  /// first" means scanning all of them. The model indexes the declarations
+  /// once after sema so these queries are hash lookups. Entries keep the
+  /// order of sema's symbol list.
+  class DocumentModel {
+  public:
+    using Declarations = std::span<const cpp2::declaration_sym* const>;
+
+    /// Record a named declaration
+    void add_declaration(std::string name, const cpp2::declaration_sym* sym);
+
+    /// Record `member` as declared inside the type `type`
+    void add_member(const cpp2::declaration_node* type,
+                    const cpp2::declaration_sym* member);
+
+    /// Record a free function whose first parameter has type `type_name`,
+    /// i.e. one callable with UFCS on objects of that type
+    void add_ufcs_candidate(std::string type_name,
+                            const cpp2::declaration_sym* function);
+
+    /// Declarations named `name`
+    auto declarations_named(std::string_view name) const -> Declarations;
+
+    /// Members declared directly inside `type`
+    auto members_of(const cpp2::declaration_node* type) const -> Declarations;
+
+    /// Free functions whose first parameter has type `type_name`
+    auto ufcs_candidates(std::string_view type_name) const -> Declarations;
+
+  private:
+    using NameMap = StringMap<std::vector<const cpp2::declaration_sym*>>;
+
+    NameMap m_by_name;
+    NameMap m_ufcs_by_type;
+    std::unordered_map<const cpp2::declaration_node*,
+                       std::vector<const cpp2::declaration_sym*>>
+        m_members;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_DOCUMENT_MODEL_H
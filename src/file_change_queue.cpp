@@ -0,0 +1,73 @@
+#include "file_change_queue.h"
+
+#include <algorithm>
+
+namespace cpp2ls {
+
+  FileChangeQueue::FileChangeQueue(Callback callback,
+                                   std::chrono::milliseconds quiet,
+                                   std::chrono::milliseconds max)
+      : m_callback{std::move(callback)},
+        m_quiet{quiet},
+        m_max{std::max(max, quiet)},
+        m_worker{[this] { run(); }} {}
+
+  FileChangeQueue::~FileChangeQueue() { stop(); }
+
+  void FileChangeQueue::push(const std::filesystem::path& path,
+                             FileChangeKind kind) {
+    {
+      std::lock_guard lock{m_mutex};
+      auto now = Clock::now();
+      if (m_pending.empty()) {
+        m_first_change = now;
+      }
+      m_last_change = now;
+      m_pending.insert_or_assign(path.string(), FileChange{path, kind});
+    }
+    m_cv.notify_one();
+  }
+
+  void FileChangeQueue::stop() {
+    {
+      std::lock_guard lock{m_mutex};
+      m_stopped = true;
+      m_pending.clear();
+    }
+    m_cv.notify_one();
+    if (m_worker.joinable()) {
+      m_worker.join();
+    }
+  }
+
+  void FileChangeQueue::run() {
+    std::unique_lock lock{m_mutex};
+    while (!m_stopped) {
+      if (m_pending.empty()) {
+        m_cv.wait(lock);
+        continue;
+      }
+
+      // Wait for the burst to settle, but not past `max`
+      auto deadline
+          = std::min(m_last_change + m_quiet, m_first_change + m_max);
+      if (Clock::now() < deadline) {
+        m_cv.wait_until(lock, deadline);
+        continue;
+      }
+
+      std::vector<FileChange> changes;
+      changes.reserve(m_pending.size());
+      for (auto& [key, change] : m_pending) {
+        changes.push_back(std::move(change));
+      }
+      m_pending.clear();
+
+      // Apply without holding the lock so events keep being recorded
+      lock.unlock();
+      m_callback(std::move(changes));
+      lock.lock();
+    }
+  }
+
+}  // namespace cpp2ls
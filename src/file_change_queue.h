@@ -0,0 +1,76 @@
+#ifndef CPP2LS_FILE_CHANGE_QUEUE_H
+#define CPP2LS_FILE_CHANGE_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cpp2ls {
+
+  /// What happened to a path on disk
+  enum class FileChangeKind {
+    Changed,  // Created or modified; for a directory, its contents changed
+    Removed,  // Deleted or moved away, with everything below it
+  };
+
+  /// A change to a file or directory in the workspace
+  struct FileChange {
+    std::filesystem::path path;
+    FileChangeKind kind{FileChangeKind::Changed};
+  };
+
+  /// Collects file changes and hands them over in debounced batches
+  ///
+  /// A path has at most one pending change; a later event for it replaces
+  /// the earlier one, so a file that is rewritten several times, or deleted
+  /// and recreated by a checkout, is processed once. The batch is released
+  /// once no event arrived for `quiet`, or `max` after its first event, and
+  /// handed to the callback on the queue's own thread.
+  class FileChangeQueue {
+  public:
+    using Callback = std::function<void(std::vector<FileChange> changes)>;
+
+    explicit FileChangeQueue(
+        Callback callback,
+        std::chrono::milliseconds quiet = std::chrono::milliseconds{200},
+        std::chrono::milliseconds max = std::chrono::milliseconds{2000});
+    ~FileChangeQueue();
+
+    FileChangeQueue(const FileChangeQueue&) = delete;
+    FileChangeQueue& operator=(const FileChangeQueue&) = delete;
+
+    /// Record a change; safe to call from any thread
+    void push(const std::filesystem::path& path, FileChangeKind kind);
+
+    /// Stop the worker thread, discarding pending changes
+    void stop();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+
+    Callback m_callback;
+    std::chrono::milliseconds m_quiet;
+    std::chrono::milliseconds m_max;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::unordered_map<std::string, FileChange> m_pending;  // By path
+    Clock::time_point m_first_change;
+    Clock::time_point m_last_change;
+    bool m_stopped{false};
+
+    // Declared last so the state above exists before the worker starts
+    std::thread m_worker;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_FILE_CHANGE_QUEUE_H
@@ -0,0 +1,184 @@
+#include "file_watcher.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <format>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace cpp2ls {
+
+  namespace {
+    auto is_cpp2_file(const std::filesystem::path& path) -> bool {
+      auto ext = path.extension();
+      return ext == ".cpp2" || ext == ".h2";
+    }
+
+#ifdef __linux__
+    constexpr std::uint32_t kWatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+                                         | IN_MOVED_FROM | IN_MOVED_TO
+                                         | IN_ONLYDIR;
+#endif
+  }  // namespace
+
+  FileWatcher::FileWatcher(Callback callback)
+      : m_callback{std::move(callback)} {}
+
+  FileWatcher::~FileWatcher() { stop(); }
+
+#ifdef __linux__
+
+  bool FileWatcher::start(const std::filesystem::path& root,
+                          Lister lister) {
+    if (m_thread.joinable()) {
+      return true;
+    }
+
+    m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+      std::cerr << "inotify unavailable, not watching the workspace\n";
+      return false;
+    }
+    m_wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wake_fd < 0) {
+      ::close(m_fd);
+      m_fd = -1;
+      return false;
+    }
+
+    // Adding the watches walks the whole tree, so it runs on the thread
+    m_root = root;
+    m_lister = std::move(lister);
+    m_thread = std::thread{[this] { run(); }};
+    return true;
+  }
+
+  void FileWatcher::stop() {
+    if (m_thread.joinable()) {
+      std::uint64_t one = 1;
+      [[maybe_unused]] auto written = ::write(m_wake_fd, &one, sizeof(one));
+      m_thread.join();
+    }
+    if (m_fd >= 0) {
+      ::close(m_fd);  // Releases all watches
+      m_fd = -1;
+    }
+    if (m_wake_fd >= 0) {
+      ::close(m_wake_fd);
+      m_wake_fd = -1;
+    }
+    m_watches.clear();
+  }
+
+  void FileWatcher::run() {
+    add_watches(m_root);
+    std::cerr << std::format("Watching {} directories for changes\n",
+                             m_watches.size());
+
+    while (true) {
+      pollfd fds[2] = {{m_fd, POLLIN, 0}, {m_wake_fd, POLLIN, 0}};
+      if (::poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::cerr << "File watcher poll failed\n";
+        return;
+      }
+      if (fds[1].revents & POLLIN) {
+        return;  // stop()
+      }
+      if (fds[0].revents & POLLIN) {
+        read_events();
+      }
+    }
+  }
+
+  void FileWatcher::add_watches(const std::filesystem::path& dir) {
+    for (const auto& path : m_lister(dir)) {
+      int wd = ::inotify_add_watch(m_fd, path.c_str(), kWatchMask);
+      if (wd < 0) {
+        // Usually fs.inotify.max_user_watches; the rest is still watched
+        std::cerr << std::format("Cannot watch {}\n", path.string());
+        continue;
+      }
+      m_watches[wd] = path;
+    }
+  }
+
+  void FileWatcher::read_events() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (true) {
+      auto length = ::read(m_fd, buffer, sizeof(buffer));
+      if (length <= 0) {
+        return;  // Drained (EAGAIN) or failed
+      }
+
+      for (char* ptr = buffer; ptr < buffer + length;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(ptr);
+        ptr += sizeof(inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+          // Events were lost; have the whole workspace rescanned
+          std::cerr << "File watcher queue overflowed, rescanning\n";
+          m_callback(m_root, FileChangeKind::Changed);
+          continue;
+        }
+        if (event->mask & IN_IGNORED) {
+          m_watches.erase(event->wd);
+          continue;
+        }
+
+        auto dir = m_watches.find(event->wd);
+        if (dir == m_watches.end() || event->len == 0) {
+          continue;
+        }
+        auto path = dir->second / event->name;
+
+        if (event->mask & IN_ISDIR) {
+          if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            // Files may have landed in it before the watch was added, so the
+            // receiver rescans it as a whole; pruned directories get no watch
+            // and their rescan finds nothing
+            add_watches(path);
+            m_callback(path, FileChangeKind::Changed);
+          } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            m_callback(path, FileChangeKind::Removed);
+          }
+          continue;
+        }
+
+        if (!is_cpp2_file(path)) {
+          continue;
+        }
+        if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+          m_callback(path, FileChangeKind::Changed);
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+          m_callback(path, FileChangeKind::Removed);
+        }
+      }
+    }
+  }
+
+#else
+
+  bool FileWatcher::start(const std::filesystem::path&, Lister) {
+    return false;
+  }
+
+  void FileWatcher::stop() {}
+
+  void FileWatcher::run() {}
+
+  void FileWatcher::add_watches(const std::filesystem::path&) {}
+
+  void FileWatcher::read_events() {}
+
+#endif
+
+}  // namespace cpp2ls
@@ -0,0 +1,66 @@
+#ifndef CPP2LS_FILE_WATCHER_H
+#define CPP2LS_FILE_WATCHER_H
+
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "file_change_queue.h"
+
+namespace cpp2ls {
+
+  /// Watches a workspace for changes to cpp2 files made outside the editor
+  ///
+  /// Uses inotify, with one watch per directory the lister returns, so
+  /// pruned directories cost no watches. Directories are reported as a whole
+  /// when they appear, disappear, or when events were lost, so the receiver
+  /// rescans them. Only available on Linux; elsewhere
+  /// start() fails and the client's workspace/didChangeWatchedFiles is the
+  /// only source of changes.
+  class FileWatcher {
+  public:
+    /// Called on the watcher thread for every change
+    using Callback = std::function<void(const std::filesystem::path& path,
+                                        FileChangeKind kind)>;
+
+    /// Lists the directories to watch at and below a directory
+    using Lister = std::function<std::vector<std::filesystem::path>(
+        const std::filesystem::path& dir)>;
+
+    explicit FileWatcher(Callback callback);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /// Start watching the directories `lister` returns for `root`
+    /// Returns false if the platform has no inotify or it can't be set up
+    bool start(const std::filesystem::path& root, Lister lister);
+
+    /// Stop the watcher thread and release the watches
+    void stop();
+
+  private:
+    void run();
+
+    /// Watch `dir` and the subdirectories the lister returns for it
+    void add_watches(const std::filesystem::path& dir);
+
+    /// Read and dispatch the pending events
+    void read_events();
+
+    Callback m_callback;
+    Lister m_lister;
+    std::filesystem::path m_root;
+    int m_fd{-1};       // inotify instance
+    int m_wake_fd{-1};  // eventfd that interrupts the wait on stop()
+    std::unordered_map<int, std::filesystem::path>
+        m_watches;  // Watch descriptor -> directory; watcher thread only
+    std::thread m_thread;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_FILE_WATCHER_H
@@ -1,24 +1,39 @@
 #include "index.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <format>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define CPP2LS_HAVE_STAT 1
+#endif
+
 // NOTE: We do NOT include cppfront headers here to avoid duplicate symbol
 // errors. Instead, we use Document to index files, which already includes
 // cppfront.
 
-// Use nlohmann json for serialization
+// Use nlohmann json for the debug export
+#include "binary_io.h"
+#include "content_hash.h"
 #include "document.h"
 #include "nlohmann/json.hpp"
+#include "summary_store.h"
+#include "thread_pool.h"
 
 namespace cpp2ls {
 
   namespace {
-    // JSON serialization helpers
-    constexpr const char* kIndexVersion = "1";
+    // Cache file layout; bump the version whenever it changes
+    constexpr std::uint64_t kIndexMagic = 0x5849534c32505043;  // "CPP2LSIX"
+    constexpr std::uint32_t kIndexVersion = 4;
+    constexpr std::uint32_t kByteOrderMark = 0x01020304;
     constexpr const char* kCacheDir = ".cache/cpp2ls";
-    constexpr const char* kIndexFile = "index.json";
+    constexpr const char* kIndexFile = "index.bin";
+    constexpr const char* kJsonExportFile = "index.json";
 
     auto symbol_kind_to_string(SymbolKind kind) -> std::string {
       switch (kind) {
@@ -36,88 +51,84 @@ namespace cpp2ls {
       return "unknown";
     }
 
-    auto string_to_symbol_kind(const std::string& str) -> SymbolKind {
-      if (str == "function") return SymbolKind::Function;
-      if (str == "type") return SymbolKind::Type;
-      if (str == "namespace") return SymbolKind::Namespace;
-      if (str == "variable") return SymbolKind::Variable;
-      if (str == "alias") return SymbolKind::Alias;
-      return SymbolKind::Function;
-    }
-
-    // Convert file_time_type to integer for JSON serialization
-    // Use nanoseconds for higher precision
-    auto time_to_int(std::filesystem::file_time_type time) -> int64_t {
-      auto duration = time.time_since_epoch();
-      return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
-          .count();
-    }
-
-    auto int_to_time(int64_t ns) -> std::filesystem::file_time_type {
-      auto duration = std::chrono::nanoseconds(ns);
-      return std::filesystem::file_time_type(
-          std::chrono::duration_cast<std::filesystem::file_time_type::duration>(
-              duration));
+    /// Hash of everything a file contributes to the index, so updates that
+    /// don't change it can be skipped
+    auto summary_hash(const std::vector<IndexedSymbol>& symbols,
+                      const std::vector<IndexedOccurrences>& occurrences)
+        -> std::uint64_t {
+      // Lay the fields out in one buffer and hash that in a single pass
+      std::string bytes;
+      auto mix_bytes = [&](const void* data, std::size_t size) {
+        bytes.append(static_cast<const char*>(data), size);
+      };
+      auto mix_string = [&](const std::string& str) {
+        auto size = str.size();
+        mix_bytes(&size, sizeof(size));
+        mix_bytes(str.data(), str.size());
+      };
+      auto mix_int = [&](int value) { mix_bytes(&value, sizeof(value)); };
+
+      for (const auto& sym : symbols) {
+        mix_string(sym.name);
+        mix_int(static_cast<int>(sym.kind));
+        mix_string(sym.signature);
+        mix_int(sym.line);
+        mix_int(sym.column);
+      }
+      mix_int(-1);  // Separates symbols from occurrences
+      for (const auto& occ : occurrences) {
+        mix_string(occ.name);
+        for (const auto& pos : occ.positions) {
+          mix_int(pos.line);
+          mix_int(pos.column);
+        }
+        mix_int(-1);
+      }
+      return content_hash(bytes);
     }
   }  // namespace
 
   void ProjectIndex::set_workspace_root(const std::filesystem::path& root) {
     m_workspace_root = root;
+    m_walker = std::make_shared<WorkspaceWalker>(m_workspace_root,
+                                                 m_walk_options);
   }
 
-  auto ProjectIndex::workspace_root() const -> const std::filesystem::path& {
-    return m_workspace_root;
+  void ProjectIndex::set_walk_options(WalkOptions options) {
+    m_walk_options = std::move(options);
+    m_walker = std::make_shared<WorkspaceWalker>(m_workspace_root,
+                                                 m_walk_options);
   }
 
-  auto ProjectIndex::cache_dir() const -> std::filesystem::path {
-    return m_workspace_root / kCacheDir;
+  auto ProjectIndex::walk_options() const -> const WalkOptions& {
+    return m_walk_options;
   }
 
-  auto ProjectIndex::index_file_path() const -> std::filesystem::path {
-    return cache_dir() / kIndexFile;
+  auto ProjectIndex::walker() const
+      -> std::shared_ptr<const WorkspaceWalker> {
+    return m_walker;
   }
 
-  auto ProjectIndex::find_cpp2_files(const std::filesystem::path& dir) const
-      -> std::vector<std::filesystem::path> {
-    std::vector<std::filesystem::path> files;
-
-    if (!std::filesystem::exists(dir)) {
-      return files;
-    }
-
-    try {
-      for (const auto& entry : std::filesystem::recursive_directory_iterator(
-               dir,
-               std::filesystem::directory_options::skip_permission_denied)) {
-        if (!entry.is_regular_file()) {
-          continue;
-        }
+  void ProjectIndex::set_summary_store(
+      std::shared_ptr<const SummaryStore> store) {
+    m_summaries = std::move(store);
+  }
 
-        auto path = entry.path();
-        auto ext = path.extension().string();
+  auto ProjectIndex::summary_store() const
+      -> std::shared_ptr<const SummaryStore> {
+    return m_summaries;
+  }
 
-        // Skip files in hidden directories (like .cache, .git, etc.)
-        bool in_hidden_dir = false;
-        for (const auto& part : path) {
-          auto part_str = part.string();
-          if (!part_str.empty() && part_str[0] == '.') {
-            in_hidden_dir = true;
-            break;
-          }
-        }
-        if (in_hidden_dir) {
-          continue;
-        }
+  auto ProjectIndex::workspace_root() const -> const std::filesystem::path& {
+    return m_workspace_root;
+  }
 
-        if (ext == ".cpp2" || ext == ".h2") {
-          files.push_back(path);
-        }
-      }
-    } catch (const std::filesystem::filesystem_error& e) {
-      std::cerr << "Error scanning directory: " << e.what() << "\n";
-    }
+  auto ProjectIndex::cache_dir() const -> std::filesystem::path {
+    return m_workspace_root / kCacheDir;
+  }
 
-    return files;
+  auto ProjectIndex::index_file_path() const -> std::filesystem::path {
+    return cache_dir() / kIndexFile;
   }
 
   auto ProjectIndex::path_to_uri(const std::filesystem::path& path)
@@ -135,99 +146,199 @@ namespace cpp2ls {
     return std::filesystem::path(uri);
   }
 
-  auto ProjectIndex::index_file(const std::filesystem::path& path)
-      -> std::optional<FileIndex> {
-    std::cerr << "Indexing: " << path << "\n";
+  auto ProjectIndex::stat_file(const std::filesystem::path& path)
+      -> std::optional<FileStamp> {
+#ifdef CPP2LS_HAVE_STAT
+    struct stat info{};
+    if (::stat(path.c_str(), &info) != 0) {
+      return std::nullopt;
+    }
+#  ifdef __APPLE__
+    const auto& mtime = info.st_mtimespec;
+#  else
+    const auto& mtime = info.st_mtim;
+#  endif
+    return FileStamp{
+        static_cast<std::int64_t>(mtime.tv_sec) * 1'000'000'000
+            + mtime.tv_nsec,
+        static_cast<std::uint64_t>(info.st_size),
+        static_cast<std::uint64_t>(info.st_ino)};
+#else
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) {
+      return std::nullopt;
+    }
+    auto mtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        mtime.time_since_epoch());
+    return FileStamp{mtime_ns.count(), size, 0};
+#endif
+  }
 
-    // Read file content
-    std::ifstream file(path);
+  auto ProjectIndex::read_file(const std::filesystem::path& path,
+                               std::uint64_t size_hint)
+      -> std::optional<std::string> {
+    std::ifstream file(path, std::ios::binary);
     if (!file) {
-      std::cerr << "  Failed to open file\n";
+      std::cerr << std::format("Failed to open {}\n", path.string());
       return std::nullopt;
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string content = buffer.str();
-
-    // Get modification time
-    std::filesystem::file_time_type mtime;
-    try {
-      mtime = std::filesystem::last_write_time(path);
-    } catch (...) {
-      mtime = std::filesystem::file_time_type::clock::now();
+    // The file may have grown since it was stat'ed
+    std::string content(size_hint, '\0');
+    file.read(content.data(), static_cast<std::streamsize>(content.size()));
+    content.resize(static_cast<std::size_t>(file.gcount()));
+    if (file) {
+      std::stringstream rest;
+      rest << file.rdbuf();
+      content += rest.str();
     }
+    return content;
+  }
 
+  auto ProjectIndex::index_file(const std::filesystem::path& path,
+                                std::string_view content,
+                                const FileStamp& stamp,
+                                std::uint64_t content_hash) -> IndexedFile {
     // Create file index
-    FileIndex file_index;
+    IndexedFile indexed;
+    auto& file_index = indexed.index;
     file_index.uri = path_to_uri(path);
-    file_index.mtime = mtime;
+    file_index.stamp = stamp;
+    file_index.content_hash = content_hash;
 
     // Use Cpp2Document to parse and extract symbols
     // This reuses the existing parsing infrastructure
     Cpp2Document doc(file_index.uri);
-    doc.update(content);
+    doc.update(std::string(content));
 
     // Extract symbols from the document's function declarations map
     // For now, we'll add a method to Cpp2Document to export indexed symbols
-    auto symbols = doc.get_indexed_symbols();
-    for (auto& sym : symbols) {
-      sym.file_uri = file_index.uri;
-      file_index.symbols.push_back(std::move(sym));
+    indexed.symbols = doc.get_indexed_symbols();
+    file_index.occurrences = doc.get_indexed_occurrences();
+    for (auto& occurrences : file_index.occurrences) {
+      occurrences.file_uri = file_index.uri;
     }
+    file_index.summary_hash
+        = summary_hash(indexed.symbols, file_index.occurrences);
 
-    std::cerr << "  Found " << file_index.symbols.size() << " symbols\n";
-    return file_index;
+    // One write per file, as workers index files concurrently
+    std::cerr << std::format("Indexed {}: {} symbols\n", path.string(),
+                             indexed.symbols.size());
+    return indexed;
   }
 
-  bool ProjectIndex::scan_and_index() {
-    if (m_workspace_root.empty()) {
-      return false;
+  auto ProjectIndex::discover_files(WorkStealingPool* pool) const
+      -> std::vector<std::filesystem::path> {
+    std::cerr << "Scanning workspace: " << m_workspace_root << "\n";
+
+    auto start = std::chrono::steady_clock::now();
+    auto files = m_walker->walk(m_workspace_root, pool).files;
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start);
+    std::cerr << std::format("Found {} cpp2 files in {:.0f}ms\n", files.size(),
+                             elapsed.count() * 1000);
+    return files;
+  }
+
+  auto ProjectIndex::files_under(const std::filesystem::path& dir) const
+      -> std::vector<std::string> {
+    auto prefix = path_to_uri(dir);
+    if (!prefix.ends_with('/')) {
+      prefix += '/';
     }
 
-    std::cerr << "Scanning workspace: " << m_workspace_root << "\n";
+    std::vector<std::string> uris;
+    for (const auto& [uri, file_index] : m_file_indices) {
+      if (uri.starts_with(prefix)) {
+        uris.push_back(uri);
+      }
+    }
+    return uris;
+  }
+
+  auto ProjectIndex::indexed_stamps() const -> StampSnapshot {
+    StampSnapshot stamps;
+    stamps.reserve(m_file_indices.size());
+    for (const auto& [uri, file_index] : m_file_indices) {
+      stamps.emplace(uri,
+                     std::pair{file_index.stamp, file_index.content_hash});
+    }
+    return stamps;
+  }
+
+  auto ProjectIndex::index_stale_files(
+      std::span<const std::filesystem::path> files, const StampSnapshot& stamps,
+      const SummaryStore* summaries, TaskGroup& tasks,
+      const CancellationToken& cancel) -> std::vector<IndexedFile> {
+    std::vector<std::optional<IndexedFile>> results(files.size());
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      tasks.submit([&files, &stamps, summaries, &cancel, &results, i] {
+        if (cancel.cancelled()) {
+          return;
+        }
+        const auto& path = files[i];
+        auto stamp = stat_file(path);
+        if (!stamp) {
+          return;  // Gone since it was found
+        }
 
-    auto files = find_cpp2_files(m_workspace_root);
-    std::cerr << "Found " << files.size() << " cpp2 files\n";
+        // Same stamp: the bytes are what was indexed, don't even read them
+        auto uri = path_to_uri(path);
+        auto existing = stamps.find(uri);
+        if (existing != stamps.end() && existing->second.first == *stamp) {
+          return;
+        }
 
-    bool any_indexed = false;
+        auto content = read_file(path, stamp->size);
+        if (!content) {
+          return;
+        }
 
-    for (const auto& path : files) {
-      auto uri = path_to_uri(path);
+        // Touched, checked out or rewritten with identical bytes
+        auto hash = content_hash(*content);
+        if (existing != stamps.end() && existing->second.second == hash) {
+          IndexedFile restamped;
+          restamped.index.uri = std::move(uri);
+          restamped.index.stamp = *stamp;
+          restamped.reparsed = false;
+          results[i] = std::move(restamped);
+          return;
+        }
 
-      // Check if we need to re-index this file
-      auto existing = m_file_indices.find(uri);
-      if (existing != m_file_indices.end()) {
-        try {
-          auto current_mtime = std::filesystem::last_write_time(path);
-          if (current_mtime <= existing->second.mtime) {
-            continue;  // File hasn't changed
+        // The same bytes may have been parsed in another checkout
+        if (summaries) {
+          if (auto summary = summaries->load(hash, uri)) {
+            IndexedFile indexed;
+            indexed.index.uri = std::move(uri);
+            indexed.index.stamp = *stamp;
+            indexed.index.content_hash = hash;
+            indexed.index.occurrences = std::move(summary->occurrences);
+            indexed.symbols = std::move(summary->symbols);
+            indexed.index.summary_hash = summary_hash(
+                indexed.symbols, indexed.index.occurrences);
+            results[i] = std::move(indexed);
+            return;
           }
-        } catch (...) {
-          // If we can't get mtime, re-index
         }
-      }
 
-      // Index the file
-      auto file_index = index_file(path);
-      if (file_index) {
-        m_file_indices[uri] = std::move(*file_index);
-        any_indexed = true;
-      }
+        auto indexed = index_file(path, *content, *stamp, hash);
+        if (summaries) {
+          summaries->store(hash, indexed.symbols, indexed.index.occurrences);
+        }
+        results[i] = std::move(indexed);
+      });
     }
+    tasks.wait();
 
-    // Rebuild symbol map
-    if (any_indexed) {
-      m_symbol_map.clear();
-      for (const auto& [uri, file_index] : m_file_indices) {
-        for (const auto& sym : file_index.symbols) {
-          m_symbol_map.emplace(sym.name, &sym);
-        }
+    std::vector<IndexedFile> indexed;
+    for (auto& result : results) {
+      if (result) {
+        indexed.push_back(std::move(*result));
       }
-      m_dirty = true;
     }
-
-    return any_indexed;
+    return indexed;
   }
 
   bool ProjectIndex::load_from_cache() {
@@ -238,48 +349,58 @@ namespace cpp2ls {
 
     std::cerr << "Loading index from cache: " << path << "\n";
 
-    std::ifstream file(path);
-    if (!file) {
+    MappedFile file;
+    if (!file.open(path)) {
       return false;
     }
 
-    try {
-      nlohmann::json j;
-      file >> j;
+    m_file_indices.clear();
+    m_symbols.clear();
+    m_occurrence_map.clear();
 
-      // Check version
-      if (j["version"] != kIndexVersion) {
+    try {
+      BinaryReader in(file.bytes());
+
+      // Check format and version
+      auto magic = in.read<std::uint64_t>();
+      auto version = in.read<std::uint32_t>();
+      auto byte_order = in.read<std::uint32_t>();
+      if (magic != kIndexMagic || version != kIndexVersion
+          || byte_order != kByteOrderMark) {
         std::cerr << "Index version mismatch, rebuilding\n";
         return false;
       }
 
+      // The symbol table is stored as it is laid out in memory
+      m_symbols.read(in);
+
       // Load file indices
-      m_file_indices.clear();
-      for (const auto& file_json : j["files"]) {
+      auto file_count = in.read<std::uint64_t>();
+      for (std::uint64_t i = 0; i < file_count; ++i) {
         FileIndex file_index;
-        file_index.uri = file_json["uri"];
-        file_index.mtime = int_to_time(file_json["mtime"]);
-
-        for (const auto& sym_json : file_json["symbols"]) {
-          IndexedSymbol sym;
-          sym.name = sym_json["name"];
-          sym.kind = string_to_symbol_kind(sym_json["kind"]);
-          sym.signature = sym_json.value("signature", "");
-          sym.file_uri = file_index.uri;
-          sym.line = sym_json["line"];
-          sym.column = sym_json["column"];
-          file_index.symbols.push_back(std::move(sym));
+        file_index.uri = in.read_string();
+        file_index.stamp = in.read<FileStamp>();
+        file_index.content_hash = in.read<std::uint64_t>();
+        file_index.summary_hash = in.read<std::uint64_t>();
+
+        auto occurrence_count = in.read<std::uint64_t>();
+        for (std::uint64_t j = 0; j < occurrence_count; ++j) {
+          IndexedOccurrences occurrences;
+          occurrences.name = in.read_string();
+          occurrences.file_uri = file_index.uri;
+          in.read_array(occurrences.positions);
+          file_index.occurrences.push_back(std::move(occurrences));
         }
 
-        m_file_indices[file_index.uri] = std::move(file_index);
+        auto& stored = m_file_indices[file_index.uri];
+        stored = std::move(file_index);
+        for (const auto& occurrences : stored.occurrences) {
+          m_occurrence_map.emplace(occurrences.name, &occurrences);
+        }
       }
 
-      // Rebuild symbol map
-      m_symbol_map.clear();
-      for (const auto& [uri, file_index] : m_file_indices) {
-        for (const auto& sym : file_index.symbols) {
-          m_symbol_map.emplace(sym.name, &sym);
-        }
+      if (!in.at_end()) {
+        throw std::runtime_error("trailing data");
       }
 
       std::cerr << "Loaded " << m_file_indices.size() << " files from cache\n";
@@ -288,6 +409,9 @@ namespace cpp2ls {
 
     } catch (const std::exception& e) {
       std::cerr << "Failed to load index: " << e.what() << "\n";
+      m_file_indices.clear();
+      m_symbols.clear();
+      m_occurrence_map.clear();
       return false;
     }
   }
@@ -308,6 +432,59 @@ namespace cpp2ls {
     auto path = index_file_path();
     std::cerr << "Saving index to cache: " << path << "\n";
 
+    // Write next to the cache and rename over it, so a server that is
+    // mapping the old file never sees a partial one
+    auto temp_path = path;
+    temp_path += ".tmp";
+    {
+      std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+      if (!file) {
+        return false;
+      }
+
+      BinaryWriter out(file);
+      out.write(kIndexMagic);
+      out.write(kIndexVersion);
+      out.write(kByteOrderMark);
+
+      m_symbols.write(out);
+
+      out.write(static_cast<std::uint64_t>(m_file_indices.size()));
+      for (const auto& [uri, file_index] : m_file_indices) {
+        out.write_string(file_index.uri);
+        out.write(file_index.stamp);
+        out.write(file_index.content_hash);
+        out.write(file_index.summary_hash);
+
+        out.write(static_cast<std::uint64_t>(file_index.occurrences.size()));
+        for (const auto& occurrences : file_index.occurrences) {
+          out.write_string(occurrences.name);
+          out.write_array(std::span(occurrences.positions));
+        }
+      }
+
+      if (!file.flush()) {
+        std::cerr << "Failed to write index\n";
+        return false;
+      }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+      std::cerr << "Failed to save index: " << ec.message() << "\n";
+      return false;
+    }
+
+    if (std::getenv("CPP2LS_EXPORT_INDEX_JSON")) {
+      export_json(dir / kJsonExportFile);
+    }
+    return true;
+  }
+
+  bool ProjectIndex::export_json(const std::filesystem::path& path) const {
+    std::cerr << "Exporting index to: " << path << "\n";
+
     try {
       nlohmann::json j;
       j["version"] = kIndexVersion;
@@ -316,10 +493,14 @@ namespace cpp2ls {
       for (const auto& [uri, file_index] : m_file_indices) {
         nlohmann::json file_json;
         file_json["uri"] = file_index.uri;
-        file_json["mtime"] = time_to_int(file_index.mtime);
+        file_json["mtime"] = file_index.stamp.mtime_ns;
+        file_json["size"] = file_index.stamp.size;
+        file_json["contentHash"] = std::format("{:016x}",
+                                               file_index.content_hash);
 
         nlohmann::json symbols_json = nlohmann::json::array();
-        for (const auto& sym : file_index.symbols) {
+        for (auto id : m_symbols.in_file(uri)) {
+          auto sym = m_symbols.get(id);
           nlohmann::json sym_json;
           sym_json["name"] = sym.name;
           sym_json["kind"] = symbol_kind_to_string(sym.kind);
@@ -331,6 +512,19 @@ namespace cpp2ls {
           symbols_json.push_back(std::move(sym_json));
         }
         file_json["symbols"] = std::move(symbols_json);
+
+        // Positions as [line, column] pairs to keep the file compact
+        nlohmann::json occurrences_json = nlohmann::json::array();
+        for (const auto& occurrences : file_index.occurrences) {
+          nlohmann::json positions_json = nlohmann::json::array();
+          for (const auto& pos : occurrences.positions) {
+            positions_json.push_back({pos.line, pos.column});
+          }
+          occurrences_json.push_back(
+              {{"name", occurrences.name},
+               {"positions", std::move(positions_json)}});
+        }
+        file_json["occurrences"] = std::move(occurrences_json);
         files_json.push_back(std::move(file_json));
       }
       j["files"] = std::move(files_json);
@@ -344,91 +538,140 @@ namespace cpp2ls {
       return true;
 
     } catch (const std::exception& e) {
-      std::cerr << "Failed to save index: " << e.what() << "\n";
+      std::cerr << "Failed to export index: " << e.what() << "\n";
       return false;
     }
   }
 
-  auto ProjectIndex::lookup(const std::string& name) const
-      -> std::vector<const IndexedSymbol*> {
-    std::vector<const IndexedSymbol*> result;
-    auto range = m_symbol_map.equal_range(name);
-    for (auto it = range.first; it != range.second; ++it) {
-      result.push_back(it->second);
-    }
-    return result;
+  auto ProjectIndex::lookup(std::string_view name) const
+      -> std::span<const SymbolId> {
+    return m_symbols.find(name);
   }
 
   auto ProjectIndex::lookup_function(const std::string& name) const
       -> std::optional<IndexedSymbol> {
-    auto range = m_symbol_map.equal_range(name);
-    for (auto it = range.first; it != range.second; ++it) {
-      if (it->second->kind == SymbolKind::Function) {
-        return *it->second;
+    for (auto id : m_symbols.find(name)) {
+      auto sym = m_symbols.get(id);
+      if (sym.kind == SymbolKind::Function) {
+        return IndexedSymbol{std::string(sym.name), sym.kind,
+                             std::string(sym.signature),
+                             std::string(sym.file_uri), sym.line, sym.column};
       }
     }
     return std::nullopt;
   }
 
-  auto ProjectIndex::all_symbols() const -> std::vector<const IndexedSymbol*> {
-    std::vector<const IndexedSymbol*> result;
-    for (const auto& [uri, file_index] : m_file_indices) {
-      for (const auto& sym : file_index.symbols) {
-        result.push_back(&sym);
-      }
+  auto ProjectIndex::all_symbols() const
+      -> std::ranges::iota_view<SymbolId, SymbolId> {
+    return m_symbols.ids();
+  }
+
+  auto ProjectIndex::symbol(SymbolId id) const -> SymbolView {
+    return m_symbols.get(id);
+  }
+
+  auto ProjectIndex::lookup_occurrences(const std::string& name) const
+      -> std::vector<const IndexedOccurrences*> {
+    std::vector<const IndexedOccurrences*> result;
+    auto range = m_occurrence_map.equal_range(name);
+    for (auto it = range.first; it != range.second; ++it) {
+      result.push_back(it->second);
     }
     return result;
   }
 
-  void ProjectIndex::update_file(const std::string& uri,
-                                 const std::vector<IndexedSymbol>& symbols) {
-    // Remove old symbols from map
+  void ProjectIndex::update_file(
+      const std::string& uri, const std::vector<IndexedSymbol>& symbols,
+      const std::vector<IndexedOccurrences>& occurrences,
+      std::uint64_t content_hash) {
+    auto hash = summary_hash(symbols, occurrences);
+
+    // Most edits don't change what the file contributes to the index; the
+    // buffer's hash is still recorded so a scan can tell whether the file
+    // on disk matches it
     auto old_it = m_file_indices.find(uri);
-    if (old_it != m_file_indices.end()) {
-      // We need to rebuild the symbol map without the old symbols
-      // This is inefficient but simple - could be optimized later
+    if (old_it != m_file_indices.end() && old_it->second.summary_hash == hash) {
+      if (old_it->second.content_hash != content_hash) {
+        old_it->second.content_hash = content_hash;
+        old_it->second.stamp = {};
+        m_dirty = true;
+      }
+      return;
     }
 
     // Update file index
-    FileIndex file_index;
+    IndexedFile indexed;
+    auto& file_index = indexed.index;
     file_index.uri = uri;
-    file_index.mtime = std::filesystem::file_time_type::clock::now();
-
-    // Copy symbols and set their file_uri
-    file_index.symbols.reserve(symbols.size());
-    for (const auto& sym : symbols) {
-      IndexedSymbol sym_copy = sym;
-      sym_copy.file_uri = uri;
-      file_index.symbols.push_back(std::move(sym_copy));
+    file_index.content_hash = content_hash;
+    file_index.summary_hash = hash;
+    indexed.symbols = symbols;
+    file_index.occurrences = occurrences;
+    for (auto& occ : file_index.occurrences) {
+      occ.file_uri = uri;
     }
 
-    m_file_indices[uri] = std::move(file_index);
+    store_file(std::move(indexed));
+
+    m_dirty = true;
+  }
 
-    // Rebuild symbol map
-    m_symbol_map.clear();
-    for (const auto& [u, fi] : m_file_indices) {
-      for (const auto& sym : fi.symbols) {
-        m_symbol_map.emplace(sym.name, &sym);
+  void ProjectIndex::add_file(IndexedFile file) {
+    if (!file.reparsed) {
+      auto it = m_file_indices.find(file.index.uri);
+      if (it != m_file_indices.end() && it->second.stamp != file.index.stamp) {
+        it->second.stamp = file.index.stamp;
+        m_dirty = true;
       }
+      return;
     }
 
+    store_file(std::move(file));
     m_dirty = true;
   }
 
   void ProjectIndex::remove_file(const std::string& uri) {
-    m_file_indices.erase(uri);
-
-    // Rebuild symbol map
-    m_symbol_map.clear();
-    for (const auto& [u, fi] : m_file_indices) {
-      for (const auto& sym : fi.symbols) {
-        m_symbol_map.emplace(sym.name, &sym);
-      }
+    auto it = m_file_indices.find(uri);
+    if (it == m_file_indices.end()) {
+      return;
     }
 
+    remove_from_maps(it->second);
+    m_file_indices.erase(it);
+
     m_dirty = true;
   }
 
+  void ProjectIndex::store_file(IndexedFile file) {
+    auto it = m_file_indices.find(file.index.uri);
+    if (it != m_file_indices.end()) {
+      remove_from_maps(it->second);
+    }
+
+    auto& stored = m_file_indices[file.index.uri];
+    stored = std::move(file.index);
+    m_symbols.add_file(stored.uri, file.symbols);
+    for (const auto& occurrences : stored.occurrences) {
+      m_occurrence_map.emplace(occurrences.name, &occurrences);
+    }
+  }
+
+  void ProjectIndex::remove_from_maps(const FileIndex& file_index) {
+    m_symbols.remove_file(file_index.uri);
+
+    // Erase only the entries pointing into this file, looking them up by
+    // the names the file contributed
+    for (const auto& occurrences : file_index.occurrences) {
+      auto [first, last] = m_occurrence_map.equal_range(occurrences.name);
+      for (auto it = first; it != last; ++it) {
+        if (it->second == &occurrences) {
+          m_occurrence_map.erase(it);
+          break;
+        }
+      }
+    }
+  }
+
   bool ProjectIndex::needs_reindex(const std::string& uri) const {
     auto it = m_file_indices.find(uri);
     if (it == m_file_indices.end()) {
@@ -436,12 +679,15 @@ namespace cpp2ls {
     }
 
     auto path = uri_to_path(uri);
-    try {
-      auto current_mtime = std::filesystem::last_write_time(path);
-      return current_mtime > it->second.mtime;
-    } catch (...) {
+    auto stamp = stat_file(path);
+    if (!stamp) {
       return true;  // If we can't check, assume we need to re-index
     }
+    if (*stamp == it->second.stamp) {
+      return false;
+    }
+    auto content = read_file(path, stamp->size);
+    return !content || content_hash(*content) != it->second.content_hash;
   }
 
   void ProjectIndex::mark_dirty() { m_dirty = true; }
@@ -2,37 +2,78 @@
 #define CPP2LS_INDEX_H
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <optional>
+#include <ranges>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "cancellation.h"
+#include "symbol_table.h"
+#include "workspace_walker.h"
+
 namespace cpp2ls {
 
-  /// Symbol kind for indexed symbols
-  enum class SymbolKind { Function, Type, Namespace, Variable, Alias };
-
-  /// Indexed symbol information
-  struct IndexedSymbol {
-    std::string name;  // Symbol name
-    SymbolKind kind{SymbolKind::Function};
-    std::string signature;  // For functions: parameter list
-    std::string file_uri;   // URI of the file containing the symbol
-    int line{0};            // 0-based line number
-    int column{0};          // 0-based column number
+  /// 0-based position of an indexed identifier
+  struct IndexedPosition {
+    int line{0};
+    int column{0};
+  };
+
+  /// Uses of one identifier within one file
+  struct IndexedOccurrences {
+    std::string name;                        // Identifier
+    std::string file_uri;                    // URI of the file using it
+    std::vector<IndexedPosition> positions;  // Sorted by position
+  };
+
+  /// What stat() says about a file; if it is unchanged, so are the bytes
+  struct FileStamp {
+    std::int64_t mtime_ns{0};  // Last modification time
+    std::uint64_t size{0};
+    std::uint64_t inode{0};  // 0 where the platform has none
+
+    auto operator==(const FileStamp&) const -> bool = default;
   };
 
   /// Index data for a single file
   struct FileIndex {
-    std::string uri;                        // File URI
-    std::filesystem::file_time_type mtime;  // Last modification time
-    std::vector<IndexedSymbol> symbols;     // Symbols defined in this file
+    std::string uri;  // File URI
+    FileStamp stamp;  // Of the file on disk; all zero if indexed from an
+                      // editor buffer, so the next scan compares contents
+    std::uint64_t content_hash{0};  // content_hash() of the indexed text
+    std::vector<IndexedOccurrences>
+        occurrences;  // Identifiers used in this file, one entry per name
+    std::uint64_t summary_hash{0};  // Hash of symbols and occurrences
+  };
+
+  /// A freshly indexed file, before its symbols move into the index
+  struct IndexedFile {
+    FileIndex index;
+    std::vector<IndexedSymbol> symbols;  // Symbols defined in the file
+
+    /// False if the file was touched but its bytes are unchanged; only
+    /// `index.stamp` is then meaningful, and the stored entry is kept
+    bool reparsed{true};
   };
 
+  class SummaryStore;
+  class TaskGroup;
+  class WorkStealingPool;
+
   /// Project-wide index for cross-file symbol resolution
   class ProjectIndex {
   public:
+    /// Stamps and content hashes of indexed files, by URI
+    using StampSnapshot = std::unordered_map<
+        std::string, std::pair<FileStamp, std::uint64_t>>;
+
     ProjectIndex() = default;
 
     /// Set the workspace root directory
@@ -41,73 +82,156 @@ namespace cpp2ls {
     /// Get the workspace root
     auto workspace_root() const -> const std::filesystem::path&;
 
+    /// Set which parts of the workspace are searched for cpp2 files
+    void set_walk_options(WalkOptions options);
+
+    /// Get the options set with set_walk_options
+    auto walk_options() const -> const WalkOptions&;
+
+    /// Get the walker that finds the workspace's cpp2 files
+    /// It is immutable, so it may be used without holding the index
+    auto walker() const -> std::shared_ptr<const WorkspaceWalker>;
+
+    /// Set the machine-wide store that parsed files are looked up in and
+    /// added to; none by default
+    void set_summary_store(std::shared_ptr<const SummaryStore> store);
+
+    /// Get the store set with set_summary_store; may be null
+    /// It is thread-safe, so it may be used without holding the index
+    auto summary_store() const -> std::shared_ptr<const SummaryStore>;
+
     /// Get the cache directory path (.cache/cpp2ls)
     auto cache_dir() const -> std::filesystem::path;
 
-    /// Get the index file path
+    /// Get the index file path (binary cache)
     auto index_file_path() const -> std::filesystem::path;
 
-    /// Scan the workspace for cpp2 files and build/update the index
-    /// Returns true if any files were indexed
-    bool scan_and_index();
+    /// Find the cpp2 files in the workspace, listing directories on `pool`
+    /// if given
+    /// Reads only the workspace root, so it may run while the index is used
+    auto discover_files(WorkStealingPool* pool = nullptr) const
+        -> std::vector<std::filesystem::path>;
+
+    /// URIs of the indexed files in `dir` or below it
+    auto files_under(const std::filesystem::path& dir) const
+        -> std::vector<std::string>;
+
+    /// Stamps and content hashes of the indexed files, for
+    /// index_stale_files
+    auto indexed_stamps() const -> StampSnapshot;
+
+    /// Parse those of `files` whose bytes changed since `stamps` was taken
+    /// Files with an unchanged stamp aren't read; files whose stamp changed
+    /// but whose content hash didn't come back with `reparsed` unset.
+    /// Contents found in `summaries` (if not null) aren't parsed, and the
+    /// summaries of those that are get added to it.
+    /// Files not yet started once `cancel` is cancelled are skipped.
+    /// The files are parsed as tasks of `tasks`, which is waited for.
+    /// Touches no index state, so the index may be queried and updated
+    /// while this runs; add the results with add_file()
+    static auto index_stale_files(std::span<const std::filesystem::path> files,
+                                  const StampSnapshot& stamps,
+                                  const SummaryStore* summaries,
+                                  TaskGroup& tasks,
+                                  const CancellationToken& cancel = {})
+        -> std::vector<IndexedFile>;
 
     /// Load index from cache file
+    /// The file is memory-mapped and its symbol table copied in as blocks
     /// Returns true if successfully loaded
     bool load_from_cache();
 
     /// Save index to cache file
+    /// Also exports it as JSON if CPP2LS_EXPORT_INDEX_JSON is set
     bool save_to_cache() const;
 
+    /// Write the index as human-readable JSON (for debugging)
+    bool export_json(const std::filesystem::path& path) const;
+
     /// Look up a symbol by name
-    /// Returns all matching symbols across all files
-    auto lookup(const std::string& name) const
-        -> std::vector<const IndexedSymbol*>;
+    /// Returns all matching symbols across all files; see symbol()
+    auto lookup(std::string_view name) const -> std::span<const SymbolId>;
 
     /// Look up a function by name
     /// Returns the first matching function (for go-to-definition)
     auto lookup_function(const std::string& name) const
         -> std::optional<IndexedSymbol>;
 
-    /// Get all symbols (for completion)
-    auto all_symbols() const -> std::vector<const IndexedSymbol*>;
+    /// Get all symbols (for completion); see symbol()
+    auto all_symbols() const -> std::ranges::iota_view<SymbolId, SymbolId>;
+
+    /// Get a symbol returned by lookup() or all_symbols()
+    /// Its strings stay valid until the index is next modified
+    auto symbol(SymbolId id) const -> SymbolView;
 
-    /// Update index for a single file
-    /// Called when a file is modified
+    /// Look up the uses of an identifier
+    /// Returns one entry per file that uses it (for find-references)
+    auto lookup_occurrences(const std::string& name) const
+        -> std::vector<const IndexedOccurrences*>;
+
+    /// Update index for a single file from an editor buffer
+    /// `content_hash` is the content_hash() of the buffer's text. Only
+    /// records the hash if its symbols and occurrences are unchanged.
     void update_file(const std::string& uri,
-                     const std::vector<IndexedSymbol>& symbols);
+                     const std::vector<IndexedSymbol>& symbols,
+                     const std::vector<IndexedOccurrences>& occurrences,
+                     std::uint64_t content_hash);
+
+    /// Add a freshly indexed file, replacing what was stored for it, or
+    /// only refresh its stamp if it wasn't reparsed
+    void add_file(IndexedFile file);
 
     /// Remove a file from the index
     void remove_file(const std::string& uri);
 
-    /// Check if a file needs re-indexing based on modification time
+    /// Check if a file's bytes differ from what was indexed
+    /// Reads and hashes the file only if its stamp changed
     bool needs_reindex(const std::string& uri) const;
 
+    /// Stat a file; returns nothing if it doesn't exist
+    static auto stat_file(const std::filesystem::path& path)
+        -> std::optional<FileStamp>;
+
     /// Mark the index as dirty (needs saving)
     void mark_dirty();
 
     /// Check if index has unsaved changes
     bool is_dirty() const;
 
-  private:
-    /// Scan a directory recursively for .cpp2 files
-    auto find_cpp2_files(const std::filesystem::path& dir) const
-        -> std::vector<std::filesystem::path>;
-
-    /// Index a single file
-    auto index_file(const std::filesystem::path& path)
-        -> std::optional<FileIndex>;
-
     /// Convert file path to URI
     static auto path_to_uri(const std::filesystem::path& path) -> std::string;
 
     /// Convert URI to file path
     static auto uri_to_path(const std::string& uri) -> std::filesystem::path;
 
+  private:
+    /// Index a single file from its content
+    /// Thread-safe; index_stale_files runs it on a pool of workers
+    static auto index_file(const std::filesystem::path& path,
+                           std::string_view content, const FileStamp& stamp,
+                           std::uint64_t content_hash) -> IndexedFile;
+
+    /// Read a whole file; returns nothing if it can't be opened
+    static auto read_file(const std::filesystem::path& path,
+                          std::uint64_t size_hint)
+        -> std::optional<std::string>;
+
+    /// Add a file to the index, replacing what was stored for it
+    void store_file(IndexedFile file);
+
+    /// Remove a file's symbols and occurrences from the lookup tables
+    void remove_from_maps(const FileIndex& file_index);
+
     std::filesystem::path m_workspace_root;
+    WalkOptions m_walk_options;
+    std::shared_ptr<const WorkspaceWalker> m_walker{
+        std::make_shared<WorkspaceWalker>(m_workspace_root, m_walk_options)};
+    std::shared_ptr<const SummaryStore> m_summaries;
     std::unordered_map<std::string, FileIndex>
         m_file_indices;  // URI -> FileIndex
-    std::unordered_multimap<std::string, const IndexedSymbol*>
-        m_symbol_map;  // name -> symbol
+    SymbolTable m_symbols;
+    std::unordered_multimap<std::string, const IndexedOccurrences*>
+        m_occurrence_map;  // name -> uses in one file
     bool m_dirty{false};
   };
 
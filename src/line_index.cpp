@@ -0,0 +1,125 @@
+#include "line_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cpp2ls {
+
+  namespace {
+    /// Append `base + i + 1` to `starts` for every '\n' at index i of `text`
+    void scan_newlines(std::string_view text, std::size_t base,
+                       std::vector<std::size_t>& starts) {
+      const char* data = text.data();
+      std::size_t size = text.size();
+      std::size_t i = 0;
+
+#if defined(__SSE2__)
+      // Compare 16 bytes at a time and visit only the set bits of the mask
+      const __m128i newline = _mm_set1_epi8('\n');
+      for (; i + 16 <= size; i += 16) {
+        auto chunk
+            = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        while (mask != 0) {
+          starts.push_back(base + i + __builtin_ctz(mask) + 1);
+          mask &= mask - 1;
+        }
+      }
+#endif
+
+      // Remaining bytes (or all of them without SSE2)
+      while (i < size) {
+        const void* found = std::memchr(data + i, '\n', size - i);
+        if (!found) {
+          break;
+        }
+        i = static_cast<const char*>(found) - data;
+        starts.push_back(base + i + 1);
+        ++i;
+      }
+    }
+  }  // namespace
+
+  LineIndex::LineIndex(std::string_view text) { build(text); }
+
+  void LineIndex::build(std::string_view text) {
+    m_starts.assign(1, 0);
+    m_starts.reserve(text.size() / 32 + 1);
+    scan_newlines(text, 0, m_starts);
+    m_size = text.size();
+  }
+
+  void LineIndex::replace(std::size_t start, std::size_t end,
+                          std::string_view text) {
+    start = std::min(start, m_size);
+    end = std::clamp(end, start, m_size);
+
+    // A line start at offset s means the byte at s - 1 is a newline, so the
+    // starts removed together with [start, end) are the ones in (start, end]
+    auto first = std::upper_bound(m_starts.begin(), m_starts.end(), start);
+    auto last = std::upper_bound(first, m_starts.end(), end);
+
+    // Shift everything after the replaced range by the size difference
+    for (auto it = last; it != m_starts.end(); ++it) {
+      *it = *it - end + start + text.size();
+    }
+
+    std::vector<std::size_t> inserted;
+    scan_newlines(text, start, inserted);
+
+    auto it = m_starts.erase(first, last);
+    m_starts.insert(it, inserted.begin(), inserted.end());
+    m_size = m_size - (end - start) + text.size();
+  }
+
+  auto LineIndex::offset_of(int line, int col) const -> std::size_t {
+    if (line < 0) {
+      return 0;
+    }
+    if (line >= line_count()) {
+      return m_size;
+    }
+    auto offset
+        = line_start(line) + static_cast<std::size_t>(std::max(col, 0));
+    return std::min(offset, line_end(line));
+  }
+
+  auto LineIndex::position_of(std::size_t offset) const -> Position {
+    offset = std::min(offset, m_size);
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), offset);
+    auto line = static_cast<int>(it - m_starts.begin()) - 1;
+    return {line, static_cast<int>(offset - m_starts[line])};
+  }
+
+  auto LineIndex::line_start(int line) const -> std::size_t {
+    if (line < 0) {
+      return 0;
+    }
+    if (line >= line_count()) {
+      return m_size;
+    }
+    return m_starts[line];
+  }
+
+  auto LineIndex::line_end(int line) const -> std::size_t {
+    if (line < 0) {
+      return 0;
+    }
+    if (line + 1 >= line_count()) {
+      return m_size;
+    }
+    return m_starts[line + 1] - 1;
+  }
+
+  auto LineIndex::line_count() const -> int {
+    return static_cast<int>(m_starts.size());
+  }
+
+  auto LineIndex::size() const -> std::size_t { return m_size; }
+
+}  // namespace cpp2ls
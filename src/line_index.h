@@ -0,0 +1,62 @@
+#ifndef CPP2LS_LINE_INDEX_H
+#define CPP2LS_LINE_INDEX_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace cpp2ls {
+
+  /// Table of line start offsets for converting between (line, column)
+  /// positions and byte offsets
+  ///
+  /// Built with a vectorized newline scan and patched in place on edits, so
+  /// position lookups never rescan the text: offset_of is O(1) and
+  /// position_of is a binary search.
+  class LineIndex {
+  public:
+    /// A 0-based (line, column) position
+    struct Position {
+      int line{0};
+      int column{0};
+    };
+
+    LineIndex() = default;
+    explicit LineIndex(std::string_view text);
+
+    /// Rebuild the index for `text`
+    void build(std::string_view text);
+
+    /// Patch the index for replacing the byte range [start, end) with `text`
+    void replace(std::size_t start, std::size_t end, std::string_view text);
+
+    /// Convert a 0-based (line, column) position to a byte offset
+    /// Columns past the end of the line are clamped to the line end, lines
+    /// past the end map to the text size
+    auto offset_of(int line, int col) const -> std::size_t;
+
+    /// Convert a byte offset to a 0-based (line, column) position
+    auto position_of(std::size_t offset) const -> Position;
+
+    /// Byte offset of the first character of a 0-based line
+    auto line_start(int line) const -> std::size_t;
+
+    /// Byte offset just past the last character of a 0-based line, not
+    /// counting its line terminator
+    auto line_end(int line) const -> std::size_t;
+
+    /// Number of lines (a trailing newline starts a new, empty line)
+    auto line_count() const -> int;
+
+    /// Size in bytes of the indexed text
+    auto size() const -> std::size_t;
+
+  private:
+    // Offsets of the first byte of every line; always starts with 0
+    std::vector<std::size_t> m_starts{0};
+    std::size_t m_size{0};
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_LINE_INDEX_H
@@ -1,9 +1,9 @@
-#include <iostream>
+#include <cstdio>
 
 #include "server.h"
 
 int main() {
-  cpp2ls::Server server{std::cin, std::cout};
+  cpp2ls::Server server{fileno(stdin), fileno(stdout)};
 
   server.run();
   return 0;
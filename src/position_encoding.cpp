@@ -0,0 +1,130 @@
+#include "position_encoding.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cpp2ls {
+
+  namespace {
+    /// Index of the first byte >= 0x80 in `text`, or its size if there is
+    /// none
+    auto find_non_ascii(std::string_view text) -> std::size_t {
+      const char* data = text.data();
+      std::size_t size = text.size();
+      std::size_t i = 0;
+
+#if defined(__SSE2__)
+      // The sign bits of 16 bytes at a time are exactly the non-ASCII ones
+      for (; i + 16 <= size; i += 16) {
+        auto chunk
+            = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(chunk));
+        if (mask != 0) {
+          return i + __builtin_ctz(mask);
+        }
+      }
+#endif
+
+      for (; i < size; ++i) {
+        if (static_cast<unsigned char>(data[i]) >= 0x80) {
+          return i;
+        }
+      }
+      return size;
+    }
+
+    /// Length in bytes of the UTF-8 sequence starting with `lead`
+    /// Stray continuation bytes count as one-byte code points
+    auto sequence_length(unsigned char lead) -> int {
+      if (lead >= 0xF0) {
+        return 4;
+      }
+      if (lead >= 0xE0) {
+        return 3;
+      }
+      if (lead >= 0xC0) {
+        return 2;
+      }
+      return 1;
+    }
+  }  // namespace
+
+  ColumnMap::ColumnMap(std::string_view line) {
+    auto first = find_non_ascii(line);
+    if (first == line.size()) {
+      return;
+    }
+
+    // Everything before the first non-ASCII byte is one unit per byte
+    int utf16 = static_cast<int>(first);
+    int utf32 = static_cast<int>(first);
+    auto size = static_cast<int>(line.size());
+    for (int i = static_cast<int>(first); i < size;) {
+      auto c = static_cast<unsigned char>(line[i]);
+      if (c < 0x80) {
+        ++i;
+        ++utf16;
+        ++utf32;
+        continue;
+      }
+
+      auto length = std::min(sequence_length(c), size - i);
+      m_code_points.push_back({i, utf16, utf32, length});
+      i += length;
+      utf16 += length == 4 ? 2 : 1;  // Surrogate pair outside the BMP
+      utf32 += 1;
+    }
+  }
+
+  auto ColumnMap::from_bytes(int byte_col, PositionEncoding encoding) const
+      -> int {
+    if (encoding == PositionEncoding::Utf8 || m_code_points.empty()) {
+      return byte_col;
+    }
+
+    // Last code point starting at or before the column
+    auto it = std::upper_bound(
+        m_code_points.begin(), m_code_points.end(), byte_col,
+        [](int col, const CodePoint& cp) { return col < cp.byte; });
+    if (it == m_code_points.begin()) {
+      return byte_col;
+    }
+
+    const auto& cp = *std::prev(it);
+    auto start = encoding == PositionEncoding::Utf16 ? cp.utf16 : cp.utf32;
+    if (byte_col < cp.byte + cp.length) {
+      return start;
+    }
+    auto width
+        = encoding == PositionEncoding::Utf16 && cp.length == 4 ? 2 : 1;
+    return start + width + (byte_col - cp.byte - cp.length);
+  }
+
+  auto ColumnMap::to_bytes(int col, PositionEncoding encoding) const -> int {
+    if (encoding == PositionEncoding::Utf8 || m_code_points.empty()) {
+      return col;
+    }
+
+    bool utf16 = encoding == PositionEncoding::Utf16;
+    auto it = std::upper_bound(m_code_points.begin(), m_code_points.end(), col,
+                               [utf16](int col, const CodePoint& cp) {
+                                 return col < (utf16 ? cp.utf16 : cp.utf32);
+                               });
+    if (it == m_code_points.begin()) {
+      return col;
+    }
+
+    const auto& cp = *std::prev(it);
+    auto start = utf16 ? cp.utf16 : cp.utf32;
+    auto width = utf16 && cp.length == 4 ? 2 : 1;
+    if (col < start + width) {
+      return cp.byte;
+    }
+    return cp.byte + cp.length + (col - start - width);
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,49 @@
+#ifndef CPP2LS_POSITION_ENCODING_H
+#define CPP2LS_POSITION_ENCODING_H
+
+#include <string_view>
+#include <vector>
+
+namespace cpp2ls {
+
+  /// Unit the `character` of an LSP position counts in
+  enum class PositionEncoding {
+    Utf8,   // Bytes, which is what the parser and buffers use internally
+    Utf16,  // The LSP default
+    Utf32   // Code points
+  };
+
+  /// Column conversion table for one line of text
+  ///
+  /// Lines that are pure ASCII (by far the most common case, detected with a
+  /// vectorized scan) need no table at all since every encoding counts them
+  /// the same. Other lines record the position of each multi-byte code
+  /// point, so conversions are a binary search instead of a decode of the
+  /// line prefix.
+  class ColumnMap {
+  public:
+    ColumnMap() = default;
+    explicit ColumnMap(std::string_view line);
+
+    /// Convert a byte column to a column in `encoding`
+    auto from_bytes(int byte_col, PositionEncoding encoding) const -> int;
+
+    /// Convert a column in `encoding` to a byte column
+    /// Columns inside a code point snap to its start
+    auto to_bytes(int col, PositionEncoding encoding) const -> int;
+
+  private:
+    /// A multi-byte code point and the units that precede it
+    struct CodePoint {
+      int byte;    // Byte column of its first byte
+      int utf16;   // UTF-16 column it starts at
+      int utf32;   // UTF-32 column it starts at
+      int length;  // Length in bytes
+    };
+
+    std::vector<CodePoint> m_code_points;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_POSITION_ENCODING_H
@@ -0,0 +1,45 @@
+#include "reference_postings.h"
+
+#include <algorithm>
+
+namespace cpp2ls {
+
+  void ReferencePostings::add(const cpp2::declaration_sym* declaration,
+                              SourcePosition where) {
+    m_by_declaration[declaration].push_back(where);
+  }
+
+  void ReferencePostings::add_unresolved(std::string name,
+                                         SourcePosition where) {
+    m_unresolved[std::move(name)].push_back(where);
+  }
+
+  void ReferencePostings::finalize() {
+    for (auto& [declaration, occurrences] : m_by_declaration) {
+      std::ranges::sort(occurrences);
+    }
+    for (auto& [name, occurrences] : m_unresolved) {
+      std::ranges::sort(occurrences);
+    }
+  }
+
+  auto ReferencePostings::occurrences_of(
+      const cpp2::declaration_sym* declaration) const
+      -> std::span<const SourcePosition> {
+    auto it = m_by_declaration.find(declaration);
+    if (it == m_by_declaration.end()) {
+      return {};
+    }
+    return it->second;
+  }
+
+  auto ReferencePostings::unresolved(std::string_view name) const
+      -> std::span<const SourcePosition> {
+    auto it = m_unresolved.find(name);
+    if (it == m_unresolved.end()) {
+      return {};
+    }
+    return it->second;
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,56 @@
+#ifndef CPP2LS_REFERENCE_POSTINGS_H
+#define CPP2LS_REFERENCE_POSTINGS_H
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "source_position.h"
+#include "string_hash.h"
+
+// Forward declarations from cppfront
+namespace cpp2 {
+  struct declaration_sym;
+}  // namespace cpp2
+
+namespace cpp2ls {
+
+  /// Inverted index from declarations to the places that refer to them
+  ///
+  /// sema maps each identifier token to its declaration; answering "where
+  /// is this declaration used" from that means scanning every entry. The
+  /// postings invert the map once per parse into position-sorted lists, so
+  /// a references query costs O(result size). Identifiers sema could not
+  /// resolve are kept by name, for matching against declarations that live
+  /// in other sections.
+  class ReferencePostings {
+  public:
+    /// Record a use of `declaration` at `where`
+    void add(const cpp2::declaration_sym* declaration, SourcePosition where);
+
+    /// Record an identifier named `name` that resolved to no declaration
+    void add_unresolved(std::string name, SourcePosition where);
+
+    /// Sort every posting list; call once after everything is added
+    void finalize();
+
+    /// Uses of `declaration`, in position order
+    auto occurrences_of(const cpp2::declaration_sym* declaration) const
+        -> std::span<const SourcePosition>;
+
+    /// Unresolved identifiers named `name`, in position order
+    auto unresolved(std::string_view name) const
+        -> std::span<const SourcePosition>;
+
+  private:
+    std::unordered_map<const cpp2::declaration_sym*,
+                       std::vector<SourcePosition>>
+        m_by_declaration;
+    StringMap<std::vector<SourcePosition>> m_unresolved;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_REFERENCE_POSTINGS_H
@@ -0,0 +1,121 @@
+#include "reparse_scheduler.h"
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+
+namespace cpp2ls {
+
+  namespace {
+    // Number of recent parse times the adaptive delay is computed from
+    constexpr std::size_t kParseTimeSamples = 8;
+  }  // namespace
+
+  ReparseScheduler::ReparseScheduler(Callback callback)
+      : m_callback{std::move(callback)}, m_worker{[this] { run(); }} {}
+
+  ReparseScheduler::~ReparseScheduler() { stop(); }
+
+  void ReparseScheduler::set_options(const DebounceOptions& options) {
+    std::lock_guard lock{m_mutex};
+    m_options = options;
+    m_options.max = std::max(m_options.max, m_options.min);
+  }
+
+  void ReparseScheduler::schedule(const std::string& uri) {
+    {
+      std::lock_guard lock{m_mutex};
+      auto now = Clock::now();
+      auto [it, inserted] = m_pending.try_emplace(uri, Pending{now, now});
+      // Keep pushing the deadline back while edits keep coming, but never
+      // past `max` after the first unparsed edit
+      it->second.deadline
+          = std::min(now + current_delay(),
+                     it->second.first_scheduled + m_options.max);
+    }
+    m_cv.notify_one();
+  }
+
+  void ReparseScheduler::cancel(const std::string& uri) {
+    std::lock_guard lock{m_mutex};
+    m_pending.erase(uri);
+  }
+
+  auto ReparseScheduler::delay() const -> std::chrono::milliseconds {
+    std::lock_guard lock{m_mutex};
+    return current_delay();
+  }
+
+  void ReparseScheduler::stop() {
+    {
+      std::lock_guard lock{m_mutex};
+      m_stopped = true;
+      m_pending.clear();
+    }
+    m_cv.notify_one();
+    if (m_worker.joinable()) {
+      m_worker.join();
+    }
+  }
+
+  auto ReparseScheduler::current_delay() const -> std::chrono::milliseconds {
+    if (m_parse_times.empty()) {
+      return m_options.min;
+    }
+
+    auto samples = m_parse_times;
+    auto middle = samples.begin() + samples.size() / 2;
+    std::nth_element(samples.begin(), middle, samples.end());
+
+    auto scaled = std::chrono::duration_cast<std::chrono::milliseconds>(
+        *middle * m_options.parse_time_ratio);
+    return std::clamp(scaled, m_options.min, m_options.max);
+  }
+
+  void ReparseScheduler::record_parse_time(Clock::duration elapsed) {
+    if (m_parse_times.size() < kParseTimeSamples) {
+      m_parse_times.push_back(elapsed);
+    } else {
+      m_parse_times[m_next_sample] = elapsed;
+    }
+    m_next_sample = (m_next_sample + 1) % kParseTimeSamples;
+  }
+
+  void ReparseScheduler::run() {
+    std::unique_lock lock{m_mutex};
+    while (!m_stopped) {
+      if (m_pending.empty()) {
+        m_cv.wait(lock);
+        continue;
+      }
+
+      auto next = std::min_element(m_pending.begin(), m_pending.end(),
+                                   [](const auto& a, const auto& b) {
+                                     return a.second.deadline
+                                            < b.second.deadline;
+                                   });
+      if (Clock::now() < next->second.deadline) {
+        m_cv.wait_until(lock, next->second.deadline);
+        continue;
+      }
+
+      auto uri = next->first;
+      m_pending.erase(next);
+
+      // Parse without holding the lock so edits can keep being scheduled
+      lock.unlock();
+      auto start = Clock::now();
+      m_callback(uri);
+      auto elapsed = Clock::now() - start;
+      lock.lock();
+
+      record_parse_time(elapsed);
+      std::cerr << std::format(
+          "Reparsed {} in {}ms (debounce now {}ms)\n", uri,
+          std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
+              .count(),
+          current_delay().count());
+    }
+  }
+
+}  // namespace cpp2ls
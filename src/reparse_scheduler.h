@@ -0,0 +1,91 @@
+#ifndef CPP2LS_REPARSE_SCHEDULER_H
+#define CPP2LS_REPARSE_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cpp2ls {
+
+  /// Debounce settings for background re-parsing
+  struct DebounceOptions {
+    /// Shortest delay between the last edit and the re-parse
+    std::chrono::milliseconds min{50};
+
+    /// Longest delay, and the longest a burst of edits can postpone a parse
+    std::chrono::milliseconds max{500};
+
+    /// The delay tracks this multiple of the recent median parse time
+    double parse_time_ratio{1.0};
+  };
+
+  /// Coalesces document edits into debounced re-parses on a worker thread
+  ///
+  /// Each document has at most one pending slot; scheduling it again only
+  /// pushes its deadline back, so a burst of edits produces a single parse of
+  /// the latest text. The debounce window adapts to the measured parse time:
+  /// files that take longer to parse wait longer for the typing to settle.
+  class ReparseScheduler {
+  public:
+    /// Runs the parse for `uri` on the worker thread
+    using Callback = std::function<void(const std::string& uri)>;
+
+    explicit ReparseScheduler(Callback callback);
+    ~ReparseScheduler();
+
+    ReparseScheduler(const ReparseScheduler&) = delete;
+    ReparseScheduler& operator=(const ReparseScheduler&) = delete;
+
+    /// Replace the debounce settings
+    void set_options(const DebounceOptions& options);
+
+    /// Request a re-parse of `uri` once its debounce window expires
+    void schedule(const std::string& uri);
+
+    /// Drop any pending re-parse of `uri`
+    void cancel(const std::string& uri);
+
+    /// Current debounce delay, derived from recent parse times
+    auto delay() const -> std::chrono::milliseconds;
+
+    /// Stop the worker thread, discarding pending work
+    void stop();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+      Clock::time_point deadline;
+      Clock::time_point first_scheduled;
+    };
+
+    void run();
+
+    /// delay() without taking the lock
+    auto current_delay() const -> std::chrono::milliseconds;
+
+    /// Remember how long a parse took, keeping the last few samples
+    void record_parse_time(Clock::duration elapsed);
+
+    Callback m_callback;
+    DebounceOptions m_options;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::unordered_map<std::string, Pending> m_pending;  // URI -> slot
+    std::vector<Clock::duration> m_parse_times;          // Ring buffer
+    std::size_t m_next_sample{0};
+    bool m_stopped{false};
+
+    // Declared last so the state above exists before the worker starts
+    std::thread m_worker;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_REPARSE_SCHEDULER_H
@@ -0,0 +1,207 @@
+#ifndef CPP2LS_REQUEST_DISPATCHER_H
+#define CPP2LS_REQUEST_DISPATCHER_H
+
+#include <array>
+#include <exception>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "cancellation.h"
+#include "langsvr/json/builder.h"
+#include "langsvr/json/value.h"
+#include "langsvr/lsp/decode.h"
+#include "langsvr/lsp/encode.h"
+#include "langsvr/lsp/lsp.h"
+#include "thread_pool.h"
+
+namespace cpp2ls {
+
+  /// Answers read-only requests on a pool of workers
+  ///
+  /// A request is decoded, handled, and its response encoded and sent on a
+  /// worker of a shared pool, at the priority it was dispatched with, and
+  /// together with the Context it was dispatched with: an immutable
+  /// view of the server state as of its arrival. Requests thus observe every
+  /// notification received before them, and a slow one no longer holds up
+  /// those behind it. Responses go out as requests finish, possibly out of
+  /// order, which JSON-RPC allows.
+  ///
+  /// Each request carries a CancellationToken that cancel() trips. A request
+  /// cancelled before a worker picks it up isn't handled at all, and one
+  /// cancelled while it runs has its result replaced by a RequestCancelled
+  /// error.
+  template <typename Context>
+  class RequestDispatcher {
+  public:
+    /// Sends one encoded response; called by several workers at once
+    using Sender = std::function<void(std::string_view)>;
+
+    /// Answer requests on `pool`, which must finish the dispatched ones
+    /// before the dispatcher goes away
+    RequestDispatcher(Sender sender, WorkStealingPool& pool)
+        : m_sender{std::move(sender)}, m_pool{pool} {}
+
+    RequestDispatcher(const RequestDispatcher&) = delete;
+    RequestDispatcher& operator=(const RequestDispatcher&) = delete;
+
+    /// Answer `Request`s with `handler(request, context, cancel)`, which
+    /// returns a `Request::ResultType` and may stop early once the
+    /// CancellationToken `cancel` is cancelled
+    /// Handlers must all be added before the first dispatch()
+    template <typename Request, typename Handler>
+    void add(Handler handler) {
+      m_handlers[std::string{Request::kMethod}]
+          = [this, handler = std::move(handler)](
+                langsvr::json::I64 id, const langsvr::json::Value& message,
+                langsvr::json::Builder& json, const Context& context,
+                const CancellationToken& cancel) {
+              Request request;
+              if constexpr (Request::kHasParams) {
+                auto params = message.Get("params");
+                if (params != langsvr::Success) {
+                  return log_failure(Request::kMethod, params.Failure());
+                }
+                auto decoded = langsvr::lsp::Decode(*params.Get(), request);
+                if (decoded != langsvr::Success) {
+                  return log_failure(Request::kMethod, decoded.Failure());
+                }
+              }
+
+              auto value = handler(request, context, cancel);
+              if (cancel.cancelled()) {
+                return send_cancelled(id, json);
+              }
+              auto result = langsvr::lsp::Encode(value, json);
+              if (result != langsvr::Success) {
+                return log_failure(Request::kMethod, result.Failure());
+              }
+              send_response(id, "result", result.Get(), json);
+            };
+    }
+
+    /// Whether `message` is a request answered here
+    bool handles(const langsvr::json::Value& message) const {
+      auto method = message.Get<langsvr::json::String>("method");
+      return method == langsvr::Success && message.Has("id")
+             && m_handlers.contains(method.Get());
+    }
+
+    /// Answer `message`, for which handles() is true, on a worker
+    /// `json` owns `message` and is kept alive until the response is sent
+    void dispatch(std::shared_ptr<langsvr::json::Builder> json,
+                  const langsvr::json::Value& message, Context context,
+                  TaskPriority priority) {
+      auto id = message.Get<langsvr::json::I64>("id");
+      if (id != langsvr::Success) {
+        std::cerr << std::format("Unsupported request id: {}\n",
+                                 id.Failure().reason);
+        return;
+      }
+      const auto& handler
+          = m_handlers.at(message.Get<langsvr::json::String>("method").Get());
+      auto cancel = CancellationToken::create();
+      {
+        std::lock_guard lock{m_pending_mutex};
+        m_pending[id.Get()] = cancel;
+      }
+      m_pool.submit(
+          [this, &handler, id = id.Get(), json = std::move(json),
+           message = &message, context = std::move(context),
+           cancel = std::move(cancel)] {
+            // Forget the request however the handler ends
+            struct Forget {
+              RequestDispatcher* dispatcher;
+              langsvr::json::I64 id;
+              ~Forget() {
+                std::lock_guard lock{dispatcher->m_pending_mutex};
+                dispatcher->m_pending.erase(id);
+              }
+            } forget{this, id};
+
+            if (cancel.cancelled()) {
+              send_cancelled(id, *json);
+              return;
+            }
+            // The client waits for an answer even when the handler fails
+            try {
+              handler(id, *message, *json, context, cancel);
+            } catch (const std::exception& e) {
+              send_error(id, langsvr::lsp::ErrorCodes::kInternalError,
+                         e.what(), *json);
+            } catch (...) {
+              send_error(id, langsvr::lsp::ErrorCodes::kInternalError,
+                         "Unknown error", *json);
+            }
+          },
+          priority);
+    }
+
+    /// Cancel the request `id`, if it is still pending; any thread
+    void cancel(langsvr::json::I64 id) {
+      std::lock_guard lock{m_pending_mutex};
+      if (auto it = m_pending.find(id); it != m_pending.end()) {
+        it->second.cancel();
+      }
+    }
+
+  private:
+    using Handler = std::function<void(
+        langsvr::json::I64 id, const langsvr::json::Value& message,
+        langsvr::json::Builder& json, const Context& context,
+        const CancellationToken& cancel)>;
+
+    static void log_failure(std::string_view method,
+                            const langsvr::Failure& failure) {
+      std::cerr << std::format("Failed to answer {}: {}\n", method,
+                               failure.reason);
+    }
+
+    void send_response(langsvr::json::I64 id, std::string_view member,
+                       const langsvr::json::Value* value,
+                       langsvr::json::Builder& json) {
+      std::array members{
+          langsvr::json::Builder::Member{"id", json.I64(id)},
+          langsvr::json::Builder::Member{"jsonrpc", json.String("2.0")},
+          langsvr::json::Builder::Member{std::string{member}, value},
+      };
+      m_sender(json.Object(members)->Json());
+    }
+
+    /// Answer `id` with an error; `Code` is ErrorCodes or LSPErrorCodes
+    template <typename Code>
+    void send_error(langsvr::json::I64 id, Code code, std::string_view message,
+                    langsvr::json::Builder& json) {
+      std::array members{
+          langsvr::json::Builder::Member{
+              "code", langsvr::lsp::Encode(code, json).Get()},
+          langsvr::json::Builder::Member{"message",
+                                         json.String(std::string{message})},
+      };
+      send_response(id, "error", json.Object(members), json);
+    }
+
+    void send_cancelled(langsvr::json::I64 id, langsvr::json::Builder& json) {
+      send_error(id, langsvr::lsp::LSPErrorCodes::kRequestCancelled,
+                 "Request cancelled", json);
+    }
+
+    Sender m_sender;
+    std::unordered_map<std::string, Handler> m_handlers;  // By method
+
+    // Requests dispatched and not yet answered, by id
+    std::mutex m_pending_mutex;
+    std::unordered_map<langsvr::json::I64, CancellationToken> m_pending;
+
+    WorkStealingPool& m_pool;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_REQUEST_DISPATCHER_H
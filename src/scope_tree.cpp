@@ -0,0 +1,84 @@
+#include "scope_tree.h"
+
+#include <algorithm>
+
+namespace cpp2ls {
+
+  void ScopeTree::add_scope(Kind kind,
+                            const cpp2::declaration_node* declaration,
+                            SourcePosition start, SourcePosition end) {
+    m_scopes.push_back({kind, declaration, start, end, kFileScope, {}});
+  }
+
+  void ScopeTree::add_declaration(const cpp2::declaration_sym* sym,
+                                  const cpp2::declaration_node* node,
+                                  SourcePosition position) {
+    auto order = static_cast<int>(m_pending.size());
+    m_pending.push_back({sym, node, position, order});
+  }
+
+  void ScopeTree::finalize() {
+    // Outer scopes first when two start at the same place
+    std::stable_sort(m_scopes.begin(), m_scopes.end(),
+                     [](const Scope& a, const Scope& b) {
+                       return a.start < b.start
+                              || (a.start == b.start && a.end > b.end);
+                     });
+
+    // Scopes nest, so the open scopes form a stack: pop those that ended
+    // before this one starts, and whatever is left on top is the parent
+    std::vector<int> open;
+    for (int i = 0; i < static_cast<int>(m_scopes.size()); ++i) {
+      while (!open.empty() && m_scopes[open.back()].end < m_scopes[i].start) {
+        open.pop_back();
+      }
+      m_scopes[i].parent = open.empty() ? kFileScope : open.back();
+      open.push_back(i);
+    }
+
+    for (auto& declaration : m_pending) {
+      auto index = innermost(declaration.position);
+      // A function, type or namespace is declared in the scope around it,
+      // not in the one it opens
+      if (index != kFileScope
+          && m_scopes[index].declaration == declaration.node) {
+        index = m_scopes[index].parent;
+      }
+      auto& list = index == kFileScope ? m_file_declarations
+                                       : m_scopes[index].declarations;
+      list.push_back(declaration);
+    }
+    m_pending.clear();
+    m_pending.shrink_to_fit();
+  }
+
+  auto ScopeTree::innermost(SourcePosition position) const -> int {
+    // The last scope starting at or before the position either contains it
+    // or is nested in the scope that does
+    auto it = std::upper_bound(
+        m_scopes.begin(), m_scopes.end(), position,
+        [](const SourcePosition& pos, const Scope& scope) {
+          return pos < scope.start;
+        });
+    auto index = static_cast<int>(it - m_scopes.begin()) - 1;
+    while (index != kFileScope && m_scopes[index].end < position) {
+      index = m_scopes[index].parent;
+    }
+    return index;
+  }
+
+  auto ScopeTree::parent(int scope) const -> int {
+    return scope == kFileScope ? kFileScope : m_scopes[scope].parent;
+  }
+
+  auto ScopeTree::scope(int scope) const -> const Scope& {
+    return m_scopes[scope];
+  }
+
+  auto ScopeTree::declarations_in(int scope) const
+      -> std::span<const Declaration> {
+    return scope == kFileScope ? m_file_declarations
+                               : m_scopes[scope].declarations;
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,81 @@
+#ifndef CPP2LS_SCOPE_TREE_H
+#define CPP2LS_SCOPE_TREE_H
+
+#include <span>
+#include <vector>
+
+#include "source_position.h"
+
+// Forward declarations from cppfront
+namespace cpp2 {
+  struct declaration_node;
+  struct declaration_sym;
+}  // namespace cpp2
+
+namespace cpp2ls {
+
+  /// Nesting of the scopes in one section, with the declarations in each
+  ///
+  /// Scopes (namespaces, types, functions and brace blocks) are properly
+  /// nested intervals, so they are kept sorted by start position and linked
+  /// to their parents. The innermost scope around a position is a binary
+  /// search plus a short walk up the parents, and the declarations visible
+  /// there are those of the scopes on the way to the file scope.
+  class ScopeTree {
+  public:
+    enum class Kind { Namespace, Type, Function, Block };
+
+    /// Index of the file scope, the parent of all top-level scopes
+    static constexpr int kFileScope = -1;
+
+    struct Declaration {
+      const cpp2::declaration_sym* sym{nullptr};
+      const cpp2::declaration_node* node{nullptr};
+      SourcePosition position;
+      int order{0};  // Order added in, i.e. sema's symbol order
+    };
+
+    struct Scope {
+      Kind kind{Kind::Block};
+      const cpp2::declaration_node* declaration{nullptr};  // Null for blocks
+      SourcePosition start;
+      SourcePosition end;  // Inclusive
+      int parent{kFileScope};
+      std::vector<Declaration> declarations;
+    };
+
+    /// Record a scope spanning [start, end]
+    void add_scope(Kind kind, const cpp2::declaration_node* declaration,
+                   SourcePosition start, SourcePosition end);
+
+    /// Record a declaration; it is assigned to the innermost scope around
+    /// it, or the scope around that if the declaration opens the scope itself
+    void add_declaration(const cpp2::declaration_sym* sym,
+                         const cpp2::declaration_node* node,
+                         SourcePosition position);
+
+    /// Link scopes to their parents and place the declarations in them
+    /// Call once after everything is added
+    void finalize();
+
+    /// Innermost scope containing `position`, or kFileScope
+    auto innermost(SourcePosition position) const -> int;
+
+    /// Parent of a scope; kFileScope for top-level scopes
+    auto parent(int scope) const -> int;
+
+    /// A scope by index (not kFileScope)
+    auto scope(int scope) const -> const Scope&;
+
+    /// Declarations placed directly in a scope, in symbol order
+    auto declarations_in(int scope) const -> std::span<const Declaration>;
+
+  private:
+    std::vector<Scope> m_scopes;  // Sorted by start after finalize()
+    std::vector<Declaration> m_file_declarations;
+    std::vector<Declaration> m_pending;  // Added, not yet placed
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_SCOPE_TREE_H
@@ -1,44 +1,97 @@
 #include "server.h"
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <filesystem>
 #include <format>
+#include <future>
 #include <iostream>
+#include <optional>
+#include <unordered_set>
+
+#include "content_hash.h"
+#include "summary_store.h"
+#include "thread_pool.h"
+#include "work_done_progress.h"
 
 namespace cpp2ls {
 
-  // StdinReader implementation
-  StdinReader::StdinReader(std::istream& stream) : m_stream{&stream} {}
+  namespace {
+    // Token of the work done progress reported while indexing
+    constexpr const char* kIndexingProgressToken = "cpp2ls/indexing";
 
-  size_t StdinReader::Read(std::byte* out, size_t count) {
-    m_stream->read(reinterpret_cast<char*>(out),
-                   static_cast<std::streamsize>(count));
-    return static_cast<size_t>(m_stream->gcount());
-  }
+    // Files parsed between two merges into the index, per indexing worker
+    constexpr std::size_t kIndexBatchPerWorker = 8;
 
-  // StdoutWriter implementation
-  StdoutWriter::StdoutWriter(std::ostream& stream) : m_stream{&stream} {}
+    // Read an integer setting from the client's initializationOptions
+    auto get_integer_option(const langsvr::lsp::LSPObject& options,
+                            const std::string& key) -> std::optional<int64_t> {
+      auto it = options.find(key);
+      if (it == options.end()) {
+        return std::nullopt;
+      }
+      if (auto* value = it->second.Get<langsvr::lsp::Integer>()) {
+        return *value;
+      }
+      if (auto* value = it->second.Get<langsvr::lsp::Uinteger>()) {
+        return static_cast<int64_t>(*value);
+      }
+      if (auto* value = it->second.Get<langsvr::lsp::Decimal>()) {
+        return static_cast<int64_t>(*value);
+      }
+      return std::nullopt;
+    }
 
-  langsvr::Result<langsvr::SuccessType> StdoutWriter::Write(const std::byte* in,
-                                                            size_t count) {
-    m_stream->write(reinterpret_cast<const char*>(in),
-                    static_cast<std::streamsize>(count));
-    m_stream->flush();
-    if (m_stream->good()) {
-      return langsvr::Success;
+    // Read a list of strings from the client's initializationOptions
+    auto get_string_list_option(const langsvr::lsp::LSPObject& options,
+                                const std::string& key)
+        -> std::optional<std::vector<std::string>> {
+      auto it = options.find(key);
+      if (it == options.end()) {
+        return std::nullopt;
+      }
+      auto* array = it->second.Get<langsvr::lsp::LSPArray>();
+      if (!array) {
+        return std::nullopt;
+      }
+      std::vector<std::string> values;
+      for (const auto& element : *array) {
+        if (auto* value = element.Get<langsvr::lsp::String>()) {
+          values.push_back(*value);
+        }
+      }
+      return values;
     }
-    return langsvr::Failure{"Failed to write to output stream"};
-  }
+
+    // The snapshot of `uri` in `docs`, or null if it isn't open
+    auto find_document(const DocumentSnapshots& docs, const std::string& uri)
+        -> const Cpp2Document* {
+      auto it = docs.find(uri);
+      return it == docs.end() ? nullptr : it->second.get();
+    }
+  }  // namespace
 
   // Server implementation
-  Server::Server(std::istream& input, std::ostream& output)
-      : m_reader{input}, m_writer{output} {
+  Server::Server(int input_fd, int output_fd)
+      : m_writer{output_fd}, m_reader{input_fd} {
     register_handlers();
 
     // Set up the sender for the session
-    m_session.SetSender([this](std::string_view msg) {
-      return langsvr::WriteContent(m_writer, msg);
-    });
+    m_session.SetSender(
+        [this](std::string_view msg) { return send_message(msg); });
+  }
+
+  Server::~Server() {
+    m_reader.stop();
+    m_watcher.stop();
+    stop_indexing();
+    m_file_changes.stop();
+    {
+      std::lock_guard lock{m_mutex};
+      m_reparse_cancel.cancel();
+    }
+    m_reparse.stop();
   }
 
   void Server::register_handlers() {
@@ -81,57 +134,88 @@ namespace cpp2ls {
           return handle_did_close(notif);
         });
 
-    // Register textDocument/hover request handler
+    // Register $/cancelRequest notification handler
     m_session.Register(
-        [this](const langsvr::lsp::TextDocumentHoverRequest& req) {
-          return handle_hover(req);
+        [this](const langsvr::lsp::CancelRequestNotification& notif) {
+          return handle_cancel_request(notif);
         });
 
-    // Register textDocument/definition request handler
+    // Register workspace/didChangeWatchedFiles notification handler
     m_session.Register(
-        [this](const langsvr::lsp::TextDocumentDefinitionRequest& req) {
-          return handle_definition(req);
+        [this](const langsvr::lsp::WorkspaceDidChangeWatchedFilesNotification&
+                   notif) { return handle_did_change_watched_files(notif); });
+
+    // Read-only requests are answered on the dispatcher's workers
+    using Snapshots = std::shared_ptr<const DocumentSnapshots>;
+    m_queries.add<langsvr::lsp::TextDocumentHoverRequest>(
+        [this](const auto& req, const Snapshots& docs,
+               const CancellationToken&) {
+          return handle_hover(req, *docs);
         });
-
-    // Register textDocument/references request handler
-    m_session.Register(
-        [this](const langsvr::lsp::TextDocumentReferencesRequest& req) {
-          return handle_references(req);
+    m_queries.add<langsvr::lsp::TextDocumentDefinitionRequest>(
+        [this](const auto& req, const Snapshots& docs,
+               const CancellationToken&) {
+          return handle_definition(req, *docs);
         });
-
-    // Register textDocument/completion request handler
-    m_session.Register(
-        [this](const langsvr::lsp::TextDocumentCompletionRequest& req) {
-          return handle_completion(req);
+    m_queries.add<langsvr::lsp::TextDocumentReferencesRequest>(
+        [this](const auto& req, const Snapshots& docs,
+               const CancellationToken& cancel) {
+          return handle_references(req, *docs, cancel);
         });
-
-    // Register textDocument/documentSymbol request handler
-    m_session.Register(
-        [this](const langsvr::lsp::TextDocumentDocumentSymbolRequest& req) {
-          return handle_document_symbol(req);
+    m_queries.add<langsvr::lsp::TextDocumentCompletionRequest>(
+        [this](const auto& req, const Snapshots& docs,
+               const CancellationToken& cancel) {
+          return handle_completion(req, *docs, cancel);
         });
-
-    // Register textDocument/signatureHelp request handler
-    m_session.Register(
-        [this](const langsvr::lsp::TextDocumentSignatureHelpRequest& req) {
-          return handle_signature_help(req);
+    m_queries.add<langsvr::lsp::TextDocumentDocumentSymbolRequest>(
+        [this](const auto& req, const Snapshots& docs,
+               const CancellationToken&) {
+          return handle_document_symbol(req, *docs);
+        });
+    m_queries.add<langsvr::lsp::TextDocumentSignatureHelpRequest>(
+        [this](const auto& req, const Snapshots& docs,
+               const CancellationToken&) {
+          return handle_signature_help(req, *docs);
+        });
+    m_queries.add<langsvr::lsp::WorkspaceSymbolRequest>(
+        [this](const auto& req, const Snapshots& docs,
+               const CancellationToken& cancel) {
+          return handle_workspace_symbol(req, *docs, cancel);
         });
-
-    // Register workspace/symbol request handler
-    m_session.Register([this](const langsvr::lsp::WorkspaceSymbolRequest& req) {
-      return handle_workspace_symbol(req);
-    });
   }
 
   void Server::run() {
     while (m_running) {
-      auto content = langsvr::ReadContent(m_reader);
-      if (content != langsvr::Success) {
+      // Framing and JSON parsing happen on the reader thread
+      auto message = m_reader.next();
+      if (!message) {
         // EOF or read error - exit the loop
         break;
       }
+      if (!message->value) {
+        std::cerr << std::format("Error processing message: {}\n",
+                                 message->error);
+        continue;
+      }
+
+      // Read-only requests go to the workers with a snapshot of the state
+      // every earlier message left; everything else is handled here, in
+      // order
+      if (m_queries.handles(*message->value)) {
+        std::shared_ptr<const DocumentSnapshots> docs;
+        TaskPriority priority;
+        {
+          std::lock_guard lock{m_mutex};
+          docs = document_snapshots();
+          priority = request_priority(*message->value);
+        }
+        m_queries.dispatch(std::move(message->json), *message->value,
+                           std::move(docs), priority);
+        continue;
+      }
 
-      auto result = m_session.Receive(content.Get());
+      std::lock_guard lock{m_mutex};
+      auto result = m_session.Receive(*message->value, *message->json);
       if (result != langsvr::Success) {
         std::cerr << std::format("Error processing message: {}\n",
                                  result.Failure().reason);
@@ -148,38 +232,110 @@ namespace cpp2ls {
       m_workspace_root = *root_uri;
       std::cerr << "Workspace root URI: " << m_workspace_root << "\n";
 
-      // Convert URI to path and set up index
+      // Convert URI to path and set up index; the workspace is indexed in
+      // the background once the client is initialized
       if (m_workspace_root.starts_with("file://")) {
         auto root_path = std::filesystem::path(m_workspace_root.substr(7));
         m_index.set_workspace_root(root_path);
+        m_index.set_summary_store(
+            std::make_shared<SummaryStore>(SummaryStore::default_dir()));
+      }
+    }
 
-        // Try to load from cache first
-        if (!m_index.load_from_cache()) {
-          std::cerr << "No valid cache, scanning workspace...\n";
-          m_index.scan_and_index();
-          m_index.save_to_cache();
-        } else {
-          // Check for updated files even if cache loaded
-          if (m_index.scan_and_index()) {
-            m_index.save_to_cache();
+    const auto& window = req.capabilities.window;
+    m_work_done_progress
+        = window && window->work_done_progress && *window->work_done_progress;
+
+    const auto& workspace = req.capabilities.workspace;
+    m_watched_files_registration
+        = workspace && workspace->did_change_watched_files
+          && workspace->did_change_watched_files->dynamic_registration
+          && *workspace->did_change_watched_files->dynamic_registration;
+
+    // Debounce settings for background re-parsing, e.g.
+    // "initializationOptions": {"reparseDebounceMs": 100}
+    if (req.initialization_options) {
+      if (auto* options
+          = req.initialization_options->Get<langsvr::lsp::LSPObject>()) {
+        DebounceOptions debounce;
+        if (auto ms = get_integer_option(*options, "reparseDebounceMs")) {
+          debounce.min = std::chrono::milliseconds{std::max<int64_t>(*ms, 0)};
+        }
+        if (auto ms = get_integer_option(*options, "reparseDebounceMaxMs")) {
+          debounce.max = std::chrono::milliseconds{std::max<int64_t>(*ms, 0)};
+        }
+        m_reparse.set_options(debounce);
+
+        // Which files to index, e.g. "initializationOptions":
+        // {"exclude": ["third_party"], "include": ["build/gen/**"]}
+        auto walk = m_index.walk_options();
+        if (auto globs = get_string_list_option(*options, "exclude")) {
+          std::ranges::move(*globs, std::back_inserter(walk.exclude));
+        }
+        if (auto globs = get_string_list_option(*options, "include")) {
+          walk.include = std::move(*globs);
+        }
+        if (auto it = options->find("useGitignore"); it != options->end()) {
+          if (auto* value = it->second.Get<langsvr::lsp::Boolean>()) {
+            walk.use_gitignore = *value;
+          }
+        }
+        m_index.set_walk_options(std::move(walk));
+
+        // Share parsed files with other workspaces through the store in
+        // $XDG_CACHE_HOME/cpp2ls unless "useSummaryCache" is false
+        if (auto it = options->find("useSummaryCache");
+            it != options->end()) {
+          if (auto* value = it->second.Get<langsvr::lsp::Boolean>();
+              value && !*value) {
+            m_index.set_summary_store(nullptr);
           }
         }
       }
     }
 
+    // Position encoding: bytes are native to the parser, so take UTF-8 when
+    // the client offers it and fall back to the mandatory UTF-16 otherwise
+    m_position_encoding = PositionEncoding::Utf16;
+    const auto& general = req.capabilities.general;
+    if (general && general->position_encodings) {
+      const auto& encodings = *general->position_encodings;
+      auto supports = [&encodings](langsvr::lsp::PositionEncodingKind kind) {
+        return std::ranges::find(encodings, kind) != encodings.end();
+      };
+      if (supports(langsvr::lsp::PositionEncodingKind::kUTF8)) {
+        m_position_encoding = PositionEncoding::Utf8;
+      } else if (!supports(langsvr::lsp::PositionEncodingKind::kUTF16)
+                 && supports(langsvr::lsp::PositionEncodingKind::kUTF32)) {
+        m_position_encoding = PositionEncoding::Utf32;
+      }
+    }
+
     langsvr::lsp::InitializeResult result;
 
     // Set server info
     langsvr::lsp::ServerInfo server_info;
     server_info.name = "cpp2ls";
-    server_info.version = "0.1.0";
+    server_info.version = CPP2LS_VERSION;
     result.server_info = server_info;
 
     // Set capabilities
     langsvr::lsp::ServerCapabilities& caps = result.capabilities;
 
-    // Text document sync - we want full document sync for now
-    caps.text_document_sync = langsvr::lsp::TextDocumentSyncKind::kFull;
+    switch (m_position_encoding) {
+      case PositionEncoding::Utf8:
+        caps.position_encoding = langsvr::lsp::PositionEncodingKind::kUTF8;
+        break;
+      case PositionEncoding::Utf16:
+        caps.position_encoding = langsvr::lsp::PositionEncodingKind::kUTF16;
+        break;
+      case PositionEncoding::Utf32:
+        caps.position_encoding = langsvr::lsp::PositionEncodingKind::kUTF32;
+        break;
+    }
+
+    // Text document sync - incremental, so edits only send the changed range
+    caps.text_document_sync = langsvr::lsp::TextDocumentSyncKind::kIncremental;
 
     // Enable hover support
     caps.hover_provider = true;
@@ -225,6 +381,13 @@ namespace cpp2ls {
   langsvr::Result<langsvr::SuccessType> Server::handle_initialized(
       const langsvr::lsp::InitializedNotification& notif) {
     std::cerr << "Client initialized\n";
+
+    if (!m_index.workspace_root().empty() && !m_indexer.joinable()) {
+      // Watch first, so changes made while indexing aren't missed
+      watch_workspace();
+      m_indexing = true;
+      m_indexer = std::thread{[this] { index_workspace(); }};
+    }
     return langsvr::Success;
   }
 
@@ -242,13 +405,25 @@ namespace cpp2ls {
 
     std::cerr << std::format("Document opened: {}\n", uri);
 
+    m_active_uri = uri;
+
     // Create and parse the document
     auto [it, inserted] = m_documents.try_emplace(uri, uri);
     it->second.update(text);
 
     // Update the global index with symbols from this document
     auto symbols = it->second.get_indexed_symbols();
-    m_index.update_file(uri, symbols);
+    {
+      std::unique_lock index_lock{m_index_mutex};
+      m_index.update_file(uri, symbols, it->second.get_indexed_occurrences(),
+                          it->second.parse_result()->content_hash);
+    }
+
+    // Let the files it includes skip ahead in the indexing queue
+    if (m_indexing) {
+      std::ranges::move(it->second.included_files(),
+                        std::back_inserter(m_index_promoted));
+    }
 
     // Publish diagnostics
     publish_diagnostics(it->second);
@@ -261,28 +436,45 @@ namespace cpp2ls {
     const auto& uri = notif.text_document.uri;
 
     std::cerr << std::format("Document changed: {}\n", uri);
+    m_active_uri = uri;
 
     auto it = m_documents.find(uri);
     if (it == m_documents.end()) {
       return langsvr::Failure{std::format("Document not found: {}", uri)};
     }
 
-    // Since we're using Full sync, we get the entire document content
+    // Apply the changes in order
     for (const auto& change : notif.content_changes) {
-      // With Full sync, we expect TextDocumentContentChangeWholeDocument
-      if (auto* whole_doc
-          = change
-                .Get<langsvr::lsp::TextDocumentContentChangeWholeDocument>()) {
-        it->second.update(whole_doc->text);
+      if (auto* partial
+          = change.Get<langsvr::lsp::TextDocumentContentChangePartial>()) {
+        const auto& range = partial->range;
+        it->second.apply_edit(static_cast<int>(range.start.line),
+                              byte_column(it->second, range.start),
+                              static_cast<int>(range.end.line),
+                              byte_column(it->second, range.end),
+                              partial->text);
+      } else if (auto* whole_doc
+                 = change.Get<
+                     langsvr::lsp::TextDocumentContentChangeWholeDocument>()) {
+        it->second.set_text(whole_doc->text);
       }
     }
+    cancel_reparse(uri);
+
+    // Edits that restore the text of the last parse (an undo, a change
+    // typed and deleted again) need no parse at all. Hashing materializes
+    // the text, so only texts of the parsed size are hashed
+    auto parsed = it->second.parse_result();
+    if (parsed && parsed->content_size == it->second.size()
+        && parsed->content_hash == content_hash(it->second.text())) {
+      m_reparse.cancel(uri);
+      it->second.install(std::move(parsed), it->second.revision());
+      return langsvr::Success;
+    }
 
-    // Update the global index with symbols from this document
-    auto symbols = it->second.get_indexed_symbols();
-    m_index.update_file(uri, symbols);
-
-    // Publish diagnostics
-    publish_diagnostics(it->second);
+    // Re-parse once the edits settle; until then requests are answered from
+    // the last parse
+    m_reparse.schedule(uri);
 
     return langsvr::Success;
   }
@@ -299,13 +491,43 @@ namespace cpp2ls {
     clear_diag.diagnostics = {};  // Empty diagnostics clears them
     m_session.Send(clear_diag);
 
+    m_reparse.cancel(uri);
+    cancel_reparse(uri);
+    m_reparse_starved.erase(uri);
     m_documents.erase(uri);
+    if (m_active_uri == uri) {
+      m_active_uri.clear();
+    }
 
     return langsvr::Success;
   }
 
+  langsvr::Result<langsvr::SuccessType>
+  Server::handle_did_change_watched_files(
+      const langsvr::lsp::WorkspaceDidChangeWatchedFilesNotification& notif) {
+    for (const auto& event : notif.changes) {
+      m_file_changes.push(ProjectIndex::uri_to_path(event.uri),
+                          event.type == langsvr::lsp::FileChangeType::kDeleted
+                              ? FileChangeKind::Removed
+                              : FileChangeKind::Changed);
+    }
+    return langsvr::Success;
+  }
+
+  langsvr::Result<langsvr::SuccessType> Server::handle_cancel_request(
+      const langsvr::lsp::CancelRequestNotification& notif) {
+    // Only the requests answered on workers can still be running; the others
+    // were answered before this notification was read. String ids are never
+    // dispatched, so there is nothing to cancel for them.
+    if (auto* id = notif.id.Get<langsvr::lsp::Integer>()) {
+      m_queries.cancel(*id);
+    }
+    return langsvr::Success;
+  }
+
   langsvr::lsp::TextDocumentHoverRequest::ResultType Server::handle_hover(
-      const langsvr::lsp::TextDocumentHoverRequest& req) {
+      const langsvr::lsp::TextDocumentHoverRequest& req,
+      const DocumentSnapshots& docs) {
     const auto& uri = req.text_document.uri;
     const auto& pos = req.position;
 
@@ -313,14 +535,15 @@ namespace cpp2ls {
                              pos.character);
 
     // Find the document
-    auto it = m_documents.find(uri);
-    if (it == m_documents.end()) {
+    const auto* doc = find_document(docs, uri);
+    if (!doc) {
       return langsvr::lsp::Null{};
     }
 
     // Get hover info from the document
-    auto hover_info = it->second.get_hover_info(
-        static_cast<int>(pos.line), static_cast<int>(pos.character), &m_index);
+    std::shared_lock index_lock{m_index_mutex};
+    auto hover_info = doc->get_hover_info(static_cast<int>(pos.line),
+                                          byte_column(*doc, pos), &m_index);
 
     if (!hover_info) {
       return langsvr::lsp::Null{};
@@ -337,13 +560,9 @@ namespace cpp2ls {
 
     // Set range
     langsvr::lsp::Range range;
-    range.start.line
-        = static_cast<langsvr::lsp::Uinteger>(hover_info->start_line);
-    range.start.character
-        = static_cast<langsvr::lsp::Uinteger>(hover_info->start_col);
-    range.end.line = static_cast<langsvr::lsp::Uinteger>(hover_info->end_line);
-    range.end.character
-        = static_cast<langsvr::lsp::Uinteger>(hover_info->end_col);
+    range.start
+        = make_position(doc, hover_info->start_line, hover_info->start_col);
+    range.end = make_position(doc, hover_info->end_line, hover_info->end_col);
     hover.range = range;
 
     return hover;
@@ -351,7 +570,8 @@ namespace cpp2ls {
 
   langsvr::lsp::TextDocumentDefinitionRequest::ResultType
   Server::handle_definition(
-      const langsvr::lsp::TextDocumentDefinitionRequest& req) {
+      const langsvr::lsp::TextDocumentDefinitionRequest& req,
+      const DocumentSnapshots& docs) {
     const auto& uri = req.text_document.uri;
     const auto& pos = req.position;
 
@@ -359,14 +579,15 @@ namespace cpp2ls {
                              pos.line, pos.character);
 
     // Find the document
-    auto it = m_documents.find(uri);
-    if (it == m_documents.end()) {
+    const auto* doc = find_document(docs, uri);
+    if (!doc) {
       return langsvr::lsp::Null{};
     }
 
     // Get definition location from the document (uses global index)
-    auto def_loc = it->second.get_definition_location(
-        static_cast<int>(pos.line), static_cast<int>(pos.character), &m_index);
+    std::shared_lock index_lock{m_index_mutex};
+    auto def_loc = doc->get_definition_location(
+        static_cast<int>(pos.line), byte_column(*doc, pos), &m_index);
 
     if (!def_loc) {
       return langsvr::lsp::Null{};
@@ -377,13 +598,8 @@ namespace cpp2ls {
     // Use the URI from the location (supports cross-file definitions)
     location.uri = def_loc->uri.empty() ? uri : def_loc->uri;
 
-    langsvr::lsp::Range range;
-    range.start.line = static_cast<langsvr::lsp::Uinteger>(def_loc->line);
-    range.start.character
-        = static_cast<langsvr::lsp::Uinteger>(def_loc->column);
-    range.end.line = range.start.line;
-    range.end.character = range.start.character + 1;  // Minimal range
-    location.range = range;
+    location.range = make_range(find_document(docs, location.uri),
+                                def_loc->line, def_loc->column);
 
     // Wrap in Definition type (OneOf<Location, vector<Location>>)
     langsvr::lsp::Definition definition{location};
@@ -392,7 +608,8 @@ namespace cpp2ls {
 
   langsvr::lsp::TextDocumentReferencesRequest::ResultType
   Server::handle_references(
-      const langsvr::lsp::TextDocumentReferencesRequest& req) {
+      const langsvr::lsp::TextDocumentReferencesRequest& req,
+      const DocumentSnapshots& docs, const CancellationToken& cancel) {
     const auto& uri = req.text_document.uri;
     const auto& pos = req.position;
     bool include_declaration = req.context.include_declaration;
@@ -402,17 +619,19 @@ namespace cpp2ls {
         pos.character, include_declaration);
 
     // Find the document
-    auto it = m_documents.find(uri);
-    if (it == m_documents.end()) {
+    const auto* doc = find_document(docs, uri);
+    if (!doc) {
       return langsvr::lsp::Null{};
     }
 
     // Get references from the document (uses global index)
-    auto refs = it->second.get_references(static_cast<int>(pos.line),
-                                          static_cast<int>(pos.character),
-                                          include_declaration, &m_index);
+    std::shared_lock index_lock{m_index_mutex};
+    auto refs = doc->get_references(static_cast<int>(pos.line),
+                                    byte_column(*doc, pos),
+                                    include_declaration, &m_index, cancel);
+    index_lock.unlock();
 
-    if (refs.empty()) {
+    if (refs.empty() || cancel.cancelled()) {
       return langsvr::lsp::Null{};
     }
 
@@ -425,12 +644,8 @@ namespace cpp2ls {
       // Use the URI from the reference (supports cross-file references)
       location.uri = ref.uri.empty() ? uri : ref.uri;
 
-      langsvr::lsp::Range range;
-      range.start.line = static_cast<langsvr::lsp::Uinteger>(ref.line);
-      range.start.character = static_cast<langsvr::lsp::Uinteger>(ref.column);
-      range.end.line = range.start.line;
-      range.end.character = range.start.character + 1;  // Minimal range
-      location.range = range;
+      location.range
+          = make_range(find_document(docs, location.uri), ref.line, ref.column);
 
       locations.push_back(std::move(location));
     }
@@ -448,18 +663,7 @@ namespace cpp2ls {
       langsvr::lsp::Diagnostic diag;
 
       // Set range - DiagnosticInfo already uses 0-based positions
-      langsvr::lsp::Position start_pos;
-      start_pos.line = static_cast<langsvr::lsp::Uinteger>(diag_info.line);
-      start_pos.character
-          = static_cast<langsvr::lsp::Uinteger>(diag_info.column);
-
-      langsvr::lsp::Position end_pos;
-      end_pos.line = start_pos.line;
-      // Mark a reasonable range (end of line or some characters)
-      end_pos.character = start_pos.character + 1;
-
-      diag.range.start = start_pos;
-      diag.range.end = end_pos;
+      diag.range = make_range(&doc, diag_info.line, diag_info.column);
 
       // Set severity - cppfront errors are all errors (no warnings yet)
       diag.severity = langsvr::lsp::DiagnosticSeverity::kError;
@@ -484,9 +688,480 @@ namespace cpp2ls {
     }
   }
 
+  auto Server::make_range(const Cpp2Document* doc, int line, int col) const
+      -> langsvr::lsp::Range {
+    auto end = col + 1;  // Minimal range
+
+    if (doc) {
+      auto text = doc->line(line);
+      auto is_identifier_char = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+      };
+      auto word_end = static_cast<std::size_t>(std::max(col, 0));
+      while (word_end < text.size() && is_identifier_char(text[word_end])) {
+        ++word_end;
+      }
+      if (word_end > static_cast<std::size_t>(col)) {
+        end = static_cast<int>(word_end);
+      }
+    }
+
+    langsvr::lsp::Range range;
+    range.start = make_position(doc, line, col);
+    range.end = make_position(doc, line, end);
+    return range;
+  }
+
+  auto Server::make_position(const Cpp2Document* doc, int line, int col) const
+      -> langsvr::lsp::Position {
+    if (doc) {
+      col = doc->from_byte_column(line, col, m_position_encoding);
+    }
+
+    langsvr::lsp::Position pos;
+    pos.line = static_cast<langsvr::lsp::Uinteger>(line);
+    pos.character = static_cast<langsvr::lsp::Uinteger>(col);
+    return pos;
+  }
+
+  auto Server::byte_column(const Cpp2Document& doc,
+                           const langsvr::lsp::Position& pos) const -> int {
+    return doc.to_byte_column(static_cast<int>(pos.line),
+                              static_cast<int>(pos.character),
+                              m_position_encoding);
+  }
+
+  auto Server::document_snapshots()
+      -> std::shared_ptr<const DocumentSnapshots> {
+    // Documents whose text and parse are unchanged keep their snapshot, and
+    // if that is all of them, so does the set
+    auto snapshots = std::make_shared<DocumentSnapshots>();
+    bool changed = !m_snapshots || m_snapshots->size() != m_documents.size();
+    for (const auto& [uri, doc] : m_documents) {
+      std::shared_ptr<const Cpp2Document> snapshot;
+      if (m_snapshots) {
+        auto it = m_snapshots->find(uri);
+        if (it != m_snapshots->end() && it->second->revision() == doc.revision()
+            && it->second->parse_result() == doc.parse_result()) {
+          snapshot = it->second;
+        }
+      }
+      if (!snapshot) {
+        snapshot = doc.snapshot();
+        changed = true;
+      }
+      snapshots->emplace(uri, std::move(snapshot));
+    }
+
+    if (changed) {
+      m_snapshots = std::move(snapshots);
+    }
+    return m_snapshots;
+  }
+
+  auto Server::request_priority(const langsvr::json::Value& request) const
+      -> TaskPriority {
+    auto params = request.Get("params");
+    if (params != langsvr::Success) {
+      return TaskPriority::Interactive;
+    }
+    auto text_document = params.Get()->Get("textDocument");
+    if (text_document != langsvr::Success) {
+      return TaskPriority::Interactive;
+    }
+    auto uri = text_document.Get()->Get<langsvr::json::String>("uri");
+    return uri == langsvr::Success && uri.Get() != m_active_uri
+               ? TaskPriority::Query
+               : TaskPriority::Interactive;
+  }
+
+  auto Server::send_message(std::string_view message)
+      -> langsvr::Result<langsvr::SuccessType> {
+    m_writer.send(std::string{message});
+    return langsvr::Success;
+  }
+
+  void Server::send_response(std::string_view response) {
+    auto result = send_message(response);
+    if (result != langsvr::Success) {
+      std::cerr << std::format("Failed to send response: {}\n",
+                               result.Failure().reason);
+    }
+  }
+
+  void Server::reparse_in_background(const std::string& uri) {
+    std::string text;
+    std::uint64_t revision = 0;
+    std::shared_ptr<const ParseResult> previous;
+    CancellationToken cancel;
+    {
+      std::lock_guard lock{m_mutex};
+      auto it = m_documents.find(uri);
+      if (it == m_documents.end()
+          || it->second.parsed_revision() == it->second.revision()) {
+        return;
+      }
+      text = it->second.text();
+      revision = it->second.revision();
+      previous = it->second.parse_result();
+
+      m_reparse_uri = uri;
+      m_reparse_cancel = m_reparse_starved.contains(uri)
+                             ? CancellationToken{}
+                             : CancellationToken::create();
+      cancel = m_reparse_cancel;
+    }
+
+    // Sections the edits didn't touch are carried over from `previous`
+    auto result = Cpp2Document::parse(text, previous.get(), cancel);
+
+    std::lock_guard lock{m_mutex};
+    m_reparse_uri.clear();
+    m_reparse_cancel = {};
+    auto it = m_documents.find(uri);
+    if (it == m_documents.end()) {
+      return;  // Closed while parsing
+    }
+    if (!result) {
+      // Superseded by an edit, which scheduled another parse
+      m_reparse_starved.insert(uri);
+      return;
+    }
+    m_reparse_starved.erase(uri);
+    if (revision < it->second.parsed_revision()) {
+      return;  // A newer parse was already installed
+    }
+
+    it->second.install(std::move(result), revision);
+
+    // Diagnostics and symbols of an outdated revision would point at the
+    // wrong places; the pending re-parse of the newer text will publish them
+    if (revision != it->second.revision()) {
+      return;
+    }
+
+    // Update the global index with symbols from this document
+    auto symbols = it->second.get_indexed_symbols();
+    {
+      std::unique_lock index_lock{m_index_mutex};
+      m_index.update_file(uri, symbols, it->second.get_indexed_occurrences(),
+                          it->second.parse_result()->content_hash);
+    }
+
+    // Publish diagnostics
+    publish_diagnostics(it->second);
+  }
+
+  void Server::cancel_reparse(const std::string& uri) {
+    if (m_reparse_uri == uri) {
+      m_reparse_cancel.cancel();
+    }
+  }
+
+  void Server::index_workspace() {
+    auto start = std::chrono::steady_clock::now();
+
+    // Progress may only be reported on a token the client has created; the
+    // response is decoded by the main loop, so wait for it without the lock
+    std::optional<WorkDoneProgress> progress;
+    {
+      std::future<langsvr::lsp::WindowWorkDoneProgressCreateRequest::ResultType>
+          created;
+      langsvr::lsp::WindowWorkDoneProgressCreateRequest create;
+      create.token = langsvr::lsp::String{kIndexingProgressToken};
+      {
+        std::lock_guard lock{m_mutex};
+        if (m_work_done_progress) {
+          auto sent = m_session.Send(create);
+          if (sent == langsvr::Success) {
+            created = std::move(sent.Get());
+          }
+        }
+      }
+      if (created.valid()
+          && created.wait_for(std::chrono::seconds{2})
+                 == std::future_status::ready) {
+        // Reports are sent with m_mutex held
+        progress.emplace(
+            create.token,
+            [this](const langsvr::lsp::ProgressNotification& notification) {
+              auto result = m_session.Send(notification);
+              if (result != langsvr::Success) {
+                std::cerr << std::format("Failed to send progress: {}\n",
+                                         result.Failure().reason);
+              }
+            });
+      }
+    }
+
+    // Read the cache and walk the workspace without blocking requests
+    ProjectIndex loaded;
+    {
+      std::lock_guard lock{m_mutex};
+      loaded.set_workspace_root(m_index.workspace_root());
+      loaded.set_walk_options(m_index.walk_options());
+      loaded.set_summary_store(m_index.summary_store());
+      if (progress) {
+        progress->begin("Indexing", "Loading cache");
+      }
+    }
+    bool cache_loaded = loaded.load_from_cache();
+    if (!cache_loaded) {
+      std::cerr << "No valid cache, scanning workspace...\n";
+    }
+    auto files = loaded.discover_files(&m_pool);
+
+    ProjectIndex::StampSnapshot stamps;
+    std::shared_ptr<const SummaryStore> summaries;
+    {
+      std::lock_guard lock{m_mutex};
+      if (cache_loaded) {
+        std::unique_lock index_lock{m_index_mutex};
+        m_index = std::move(loaded);
+
+        // Documents opened meanwhile are newer than anything in the cache
+        for (const auto& [uri, doc] : m_documents) {
+          m_index.update_file(uri, doc.get_indexed_symbols(),
+                              doc.get_indexed_occurrences(),
+                              doc.parse_result()->content_hash);
+        }
+      }
+      stamps = m_index.indexed_stamps();
+      summaries = m_index.summary_store();
+
+      // Open documents are indexed from their text already; the files they
+      // include go first
+      for (const auto& [uri, doc] : m_documents) {
+        std::ranges::move(doc.included_files(),
+                          std::back_inserter(m_index_promoted));
+      }
+    }
+
+    std::unordered_set<std::string> remaining;
+    for (const auto& path : files) {
+      remaining.insert(ProjectIndex::path_to_uri(path));
+    }
+    auto take = [&remaining](const std::filesystem::path& path) {
+      return remaining.erase(ProjectIndex::path_to_uri(path)) > 0;
+    };
+
+    TaskGroup tasks{m_pool, TaskPriority::Background};
+    auto batch_size = m_pool.size() * kIndexBatchPerWorker;
+    std::size_t next = 0;
+    std::size_t done = 0;
+    std::size_t indexed_count = 0;
+    std::vector<std::filesystem::path> batch;
+    while (!m_stop_indexing.cancelled() && !remaining.empty()) {
+      batch.clear();
+      {
+        std::lock_guard lock{m_mutex};
+        for (const auto& path : m_index_promoted) {
+          if (take(path)) {
+            batch.push_back(path);
+          }
+        }
+        m_index_promoted.clear();
+      }
+      for (; next < files.size() && batch.size() < batch_size; ++next) {
+        if (take(files[next])) {
+          batch.push_back(files[next]);
+        }
+      }
+
+      auto results = ProjectIndex::index_stale_files(
+          batch, stamps, summaries.get(), tasks, m_stop_indexing);
+
+      std::lock_guard lock{m_mutex};
+      std::unique_lock index_lock{m_index_mutex};
+      for (auto& result : results) {
+        // The editor's text wins over the file on disk
+        if (!m_documents.contains(result.index.uri)) {
+          indexed_count += result.reparsed ? 1 : 0;
+          m_index.add_file(std::move(result));
+        }
+      }
+      index_lock.unlock();
+      done += batch.size();
+      if (progress) {
+        progress->report(done, files.size());
+      }
+    }
+
+    {
+      std::lock_guard lock{m_mutex};
+      m_indexing = false;
+      m_index_promoted.clear();
+      if (m_stop_indexing.cancelled()) {
+        // The client still shows the progress until it ends
+        if (progress) {
+          progress->end("Indexing cancelled");
+        }
+        return;
+      }
+    }
+    save_index_cache();
+
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start);
+    std::cerr << std::format(
+        "Background indexing done: {} of {} files parsed in {:.0f}ms\n",
+        indexed_count, files.size(), elapsed.count() * 1000);
+
+    std::lock_guard lock{m_mutex};
+    if (progress) {
+      progress->end(std::format("Indexed {} files", files.size()));
+    }
+  }
+
+  void Server::stop_indexing() {
+    m_stop_indexing.cancel();
+    if (m_indexer.joinable()) {
+      m_indexer.join();
+    }
+  }
+
+  void Server::save_index_cache() {
+    TaskGroup save{m_pool, TaskPriority::Background};
+    save.submit([this] {
+      std::lock_guard cache_lock{m_cache_mutex};
+      std::shared_lock index_lock{m_index_mutex};
+      m_index.save_to_cache();
+    });
+  }
+
+  void Server::watch_workspace() {
+    auto lister = [walker = m_index.walker(),
+                   pool = &m_pool](const std::filesystem::path& dir) {
+      return walker->walk(dir, pool).directories;
+    };
+    if (m_watcher.start(m_index.workspace_root(), std::move(lister))
+        || !m_watched_files_registration) {
+      return;
+    }
+
+    // {"watchers": [{"globPattern": "**/*.{cpp2,h2}"}]}
+    langsvr::lsp::LSPAny glob;
+    glob.Set(langsvr::lsp::String{"**/*.{cpp2,h2}"});
+    langsvr::lsp::LSPObject watcher;
+    watcher["globPattern"] = std::move(glob);
+    langsvr::lsp::LSPAny watcher_any;
+    watcher_any.Set(std::move(watcher));
+    langsvr::lsp::LSPAny watchers;
+    watchers.Set(langsvr::lsp::LSPArray{std::move(watcher_any)});
+    langsvr::lsp::LSPObject options;
+    options["watchers"] = std::move(watchers);
+
+    langsvr::lsp::Registration registration;
+    registration.id = "cpp2ls/watched-files";
+    registration.method
+        = langsvr::lsp::WorkspaceDidChangeWatchedFilesNotification::kMethod;
+    registration.register_options = langsvr::lsp::LSPAny{};
+    registration.register_options->Set(std::move(options));
+
+    langsvr::lsp::ClientRegisterCapabilityRequest request;
+    request.registrations.push_back(std::move(registration));
+    if (m_session.Send(request) != langsvr::Success) {
+      std::cerr << "Failed to register for watched file changes\n";
+    }
+  }
+
+  void Server::apply_file_changes(std::vector<FileChange> changes) {
+    std::shared_ptr<const WorkspaceWalker> walker;
+    {
+      std::lock_guard lock{m_mutex};
+      walker = m_index.walker();
+    }
+
+    std::vector<std::filesystem::path> changed;
+    std::vector<std::filesystem::path> removed;
+    std::vector<std::filesystem::path> rescanned;  // Directories
+    for (auto& change : changes) {
+      std::error_code ec;
+      if (change.kind == FileChangeKind::Removed
+          || !std::filesystem::exists(change.path, ec)) {
+        removed.push_back(std::move(change.path));
+      } else if (std::filesystem::is_directory(change.path, ec)) {
+        std::ranges::move(walker->walk(change.path, &m_pool).files,
+                          std::back_inserter(changed));
+        rescanned.push_back(std::move(change.path));
+      } else if (walker->accepts(change.path)) {
+        changed.push_back(std::move(change.path));
+      }
+    }
+
+    // Parse outside the lock; files whose bytes are unchanged are skipped
+    ProjectIndex::StampSnapshot stamps;
+    std::shared_ptr<const SummaryStore> summaries;
+    {
+      std::lock_guard lock{m_mutex};
+      stamps = m_index.indexed_stamps();
+      summaries = m_index.summary_store();
+    }
+    std::vector<IndexedFile> results;
+    if (!changed.empty()) {
+      TaskGroup tasks{m_pool, TaskPriority::Background};
+      results = ProjectIndex::index_stale_files(
+          changed, stamps, summaries.get(), tasks, m_stop_indexing);
+    }
+
+    std::unique_lock lock{m_mutex};
+    std::unique_lock index_lock{m_index_mutex};
+
+    // Open documents are indexed from the editor's text instead
+    std::size_t removed_count = 0;
+    auto drop = [&](const std::string& uri) {
+      if (!m_documents.contains(uri)) {
+        m_index.remove_file(uri);
+        ++removed_count;
+      }
+    };
+    for (const auto& path : removed) {
+      drop(ProjectIndex::path_to_uri(path));
+      for (const auto& uri : m_index.files_under(path)) {
+        drop(uri);
+      }
+    }
+    if (!rescanned.empty()) {
+      std::unordered_set<std::string> present;
+      for (const auto& path : changed) {
+        present.insert(ProjectIndex::path_to_uri(path));
+      }
+      for (const auto& dir : rescanned) {
+        for (const auto& uri : m_index.files_under(dir)) {
+          if (!present.contains(uri)) {
+            drop(uri);
+          }
+        }
+      }
+    }
+
+    std::size_t indexed_count = 0;
+    for (auto& result : results) {
+      if (!m_documents.contains(result.index.uri)) {
+        indexed_count += result.reparsed ? 1 : 0;
+        m_index.add_file(std::move(result));
+      }
+    }
+    index_lock.unlock();
+
+    if (indexed_count == 0 && removed_count == 0) {
+      return;
+    }
+    std::cerr << std::format(
+        "Applied file changes: {} files re-indexed, {} removed\n",
+        indexed_count, removed_count);
+
+    // Keep the cache current, unless the initial indexing will save it
+    if (!m_indexing) {
+      lock.unlock();
+      save_index_cache();
+    }
+  }
+
   langsvr::lsp::TextDocumentCompletionRequest::ResultType
   Server::handle_completion(
-      const langsvr::lsp::TextDocumentCompletionRequest& req) {
+      const langsvr::lsp::TextDocumentCompletionRequest& req,
+      const DocumentSnapshots& docs, const CancellationToken& cancel) {
     const auto& uri = req.text_document.uri;
     const auto& pos = req.position;
 
@@ -494,16 +1169,19 @@ namespace cpp2ls {
                              pos.line, pos.character);
 
     // Find the document
-    auto it = m_documents.find(uri);
-    if (it == m_documents.end()) {
+    const auto* doc = find_document(docs, uri);
+    if (!doc) {
       return langsvr::lsp::Null{};
     }
 
     // Get completion items from the document (uses global index)
-    auto completions = it->second.get_completions(
-        static_cast<int>(pos.line), static_cast<int>(pos.character), &m_index);
+    std::shared_lock index_lock{m_index_mutex};
+    auto completions = doc->get_completions(static_cast<int>(pos.line),
+                                            byte_column(*doc, pos), &m_index,
+                                            cancel);
+    index_lock.unlock();
 
-    if (completions.empty()) {
+    if (completions.empty() || cancel.cancelled()) {
       return langsvr::lsp::Null{};
     }
 
@@ -550,20 +1228,21 @@ namespace cpp2ls {
   }
 
   auto Server::handle_document_symbol(
-      const langsvr::lsp::TextDocumentDocumentSymbolRequest& req)
+      const langsvr::lsp::TextDocumentDocumentSymbolRequest& req,
+      const DocumentSnapshots& docs)
       -> langsvr::lsp::TextDocumentDocumentSymbolRequest::ResultType {
     const auto& uri = req.text_document.uri;
 
     std::cerr << std::format("Document symbol request: {}\n", uri);
 
     // Find the document
-    auto it = m_documents.find(uri);
-    if (it == m_documents.end()) {
+    const auto* doc = find_document(docs, uri);
+    if (!doc) {
       return langsvr::lsp::Null{};
     }
 
     // Get indexed symbols from the document
-    auto symbols = it->second.get_indexed_symbols();
+    auto symbols = doc->get_indexed_symbols();
 
     if (symbols.empty()) {
       return langsvr::lsp::Null{};
@@ -598,19 +1277,10 @@ namespace cpp2ls {
       }
 
       // Set range and selection range
-      langsvr::lsp::Position pos;
-      pos.line = static_cast<langsvr::lsp::Uinteger>(sym.line);
-      pos.character = static_cast<langsvr::lsp::Uinteger>(sym.column);
-
-      langsvr::lsp::Position end_pos;
-      end_pos.line = pos.line;
-      end_pos.character
-          = pos.character
-            + static_cast<langsvr::lsp::Uinteger>(sym.name.length());
-
       langsvr::lsp::Range range;
-      range.start = pos;
-      range.end = end_pos;
+      range.start = make_position(doc, sym.line, sym.column);
+      range.end = make_position(
+          doc, sym.line, sym.column + static_cast<int>(sym.name.length()));
 
       doc_sym.range = range;
       doc_sym.selection_range = range;
@@ -622,20 +1292,23 @@ namespace cpp2ls {
   }
 
   auto Server::handle_signature_help(
-      const langsvr::lsp::TextDocumentSignatureHelpRequest& req)
+      const langsvr::lsp::TextDocumentSignatureHelpRequest& req,
+      const DocumentSnapshots& docs)
       -> langsvr::lsp::TextDocumentSignatureHelpRequest::ResultType {
     const auto& uri = req.text_document.uri;
     const auto& pos = req.position;
 
     // Find the document
-    auto it = m_documents.find(uri);
-    if (it == m_documents.end()) {
+    const auto* doc = find_document(docs, uri);
+    if (!doc) {
       return langsvr::lsp::Null{};
     }
 
     // Get signature help from the document
-    auto help_opt = it->second.get_signature_help(
-        static_cast<int>(pos.line), static_cast<int>(pos.character), &m_index);
+    std::shared_lock index_lock{m_index_mutex};
+    auto help_opt = doc->get_signature_help(static_cast<int>(pos.line),
+                                            byte_column(*doc, pos), &m_index);
+    index_lock.unlock();
 
     if (!help_opt) {
       return langsvr::lsp::Null{};
@@ -671,9 +1344,11 @@ namespace cpp2ls {
   }
 
   auto Server::handle_workspace_symbol(
-      const langsvr::lsp::WorkspaceSymbolRequest& req)
+      const langsvr::lsp::WorkspaceSymbolRequest& req,
+      const DocumentSnapshots& docs, const CancellationToken& cancel)
       -> langsvr::lsp::WorkspaceSymbolRequest::ResultType {
     const std::string& query = req.query;
+    std::shared_lock index_lock{m_index_mutex};
 
     std::vector<langsvr::lsp::SymbolInformation> symbols;
 
@@ -683,14 +1358,16 @@ namespace cpp2ls {
       const size_t max_results = 500;  // Limit to avoid overwhelming the client
       size_t count = 0;
 
-      for (const auto* sym : all_syms) {
-        if (count >= max_results) break;
+      for (auto id : all_syms) {
+        if (count >= max_results || cancel.cancelled()) break;
+
+        auto sym = m_index.symbol(id);
 
         langsvr::lsp::SymbolInformation lsp_sym;
-        lsp_sym.name = sym->name;
+        lsp_sym.name = sym.name;
 
         // Map our SymbolKind to LSP SymbolKind
-        switch (sym->kind) {
+        switch (sym.kind) {
           case SymbolKind::Function:
             lsp_sym.kind = langsvr::lsp::SymbolKind::kFunction;
             break;
@@ -710,15 +1387,14 @@ namespace cpp2ls {
 
         // Set location
         langsvr::lsp::Location loc;
-        loc.uri = sym->file_uri;
+        std::string file_uri{sym.file_uri};
+        loc.uri = file_uri;
 
         langsvr::lsp::Range range;
-        range.start.line = static_cast<langsvr::lsp::Uinteger>(sym->line);
-        range.start.character
-            = static_cast<langsvr::lsp::Uinteger>(sym->column);
-        range.end.line = static_cast<langsvr::lsp::Uinteger>(sym->line);
-        range.end.character = static_cast<langsvr::lsp::Uinteger>(
-            sym->column + sym->name.length());
+        const auto* doc = find_document(docs, file_uri);
+        range.start = make_position(doc, sym.line, sym.column);
+        range.end = make_position(
+            doc, sym.line, sym.column + static_cast<int>(sym.name.length()));
         loc.range = range;
 
         lsp_sym.location = loc;
@@ -737,21 +1413,23 @@ namespace cpp2ls {
       const size_t max_results = 500;
       size_t count = 0;
 
-      for (const auto* sym : all_syms) {
-        if (count >= max_results) break;
+      for (auto id : all_syms) {
+        if (count >= max_results || cancel.cancelled()) break;
+
+        auto sym = m_index.symbol(id);
 
         // Case-insensitive substring search
-        std::string name_lower = sym->name;
+        std::string name_lower{sym.name};
         std::transform(name_lower.begin(), name_lower.end(), name_lower.begin(),
                        [](unsigned char c) { return std::tolower(c); });
 
         if (name_lower.find(query_lower) == std::string::npos) continue;
 
         langsvr::lsp::SymbolInformation lsp_sym;
-        lsp_sym.name = sym->name;
+        lsp_sym.name = sym.name;
 
         // Map our SymbolKind to LSP SymbolKind
-        switch (sym->kind) {
+        switch (sym.kind) {
           case SymbolKind::Function:
             lsp_sym.kind = langsvr::lsp::SymbolKind::kFunction;
             break;
@@ -771,15 +1449,14 @@ namespace cpp2ls {
 
         // Set location
         langsvr::lsp::Location loc;
-        loc.uri = sym->file_uri;
+        std::string file_uri{sym.file_uri};
+        loc.uri = file_uri;
 
         langsvr::lsp::Range range;
-        range.start.line = static_cast<langsvr::lsp::Uinteger>(sym->line);
-        range.start.character
-            = static_cast<langsvr::lsp::Uinteger>(sym->column);
-        range.end.line = static_cast<langsvr::lsp::Uinteger>(sym->line);
-        range.end.character = static_cast<langsvr::lsp::Uinteger>(
-            sym->column + sym->name.length());
+        const auto* doc = find_document(docs, file_uri);
+        range.start = make_position(doc, sym.line, sym.column);
+        range.end = make_position(
+            doc, sym.line, sym.column + static_cast<int>(sym.name.length()));
         loc.range = range;
 
         lsp_sym.location = loc;
@@ -1,45 +1,42 @@
 #ifndef CPP2LS_SERVER_H
 #define CPP2LS_SERVER_H
 
-#include <iostream>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "cancellation.h"
 #include "document.h"
+#include "file_change_queue.h"
+#include "file_watcher.h"
 #include "index.h"
-#include "langsvr/content_stream.h"
 #include "langsvr/lsp/lsp.h"
-#include "langsvr/reader.h"
 #include "langsvr/session.h"
-#include "langsvr/writer.h"
+#include "position_encoding.h"
+#include "reparse_scheduler.h"
+#include "request_dispatcher.h"
+#include "thread_pool.h"
+#include "transport.h"
 
 namespace cpp2ls {
 
-  /// A Reader implementation that reads from std::istream
-  class StdinReader : public langsvr::Reader {
-  public:
-    explicit StdinReader(std::istream& stream);
-    size_t Read(std::byte* out, size_t count) override;
-
-  private:
-    std::istream* m_stream;
-  };
-
-  /// A Writer implementation that writes to std::ostream
-  class StdoutWriter : public langsvr::Writer {
-  public:
-    explicit StdoutWriter(std::ostream& stream);
-    langsvr::Result<langsvr::SuccessType> Write(const std::byte* in,
-                                                size_t count) override;
-
-  private:
-    std::ostream* m_stream;
-  };
+  /// Copies of the open documents as of one moment, by URI
+  using DocumentSnapshots
+      = std::unordered_map<std::string, std::shared_ptr<const Cpp2Document>>;
 
   /// The cpp2ls Language Server
   class Server {
   public:
-    Server(std::istream& input, std::ostream& output);
+    /// Serve the client on the file descriptors `input_fd` and `output_fd`
+    Server(int input_fd, int output_fd);
+    ~Server();
 
     /// Run the server main loop
     void run();
@@ -76,42 +73,126 @@ namespace cpp2ls {
     langsvr::Result<langsvr::SuccessType> handle_did_close(
         const langsvr::lsp::TextDocumentDidCloseNotification& notif);
 
+    /// Handler for workspace/didChangeWatchedFiles notification
+    langsvr::Result<langsvr::SuccessType> handle_did_change_watched_files(
+        const langsvr::lsp::WorkspaceDidChangeWatchedFilesNotification& notif);
+
+    /// Handler for $/cancelRequest notification
+    langsvr::Result<langsvr::SuccessType> handle_cancel_request(
+        const langsvr::lsp::CancelRequestNotification& notif);
+
+    // The request handlers below run on the dispatcher's workers: they read
+    // documents from `docs` only, and the index under a shared lock. Those
+    // taking a `cancel` token give up early when the client cancels.
+
     /// Handler for textDocument/hover request
     langsvr::lsp::TextDocumentHoverRequest::ResultType handle_hover(
-        const langsvr::lsp::TextDocumentHoverRequest& req);
+        const langsvr::lsp::TextDocumentHoverRequest& req,
+        const DocumentSnapshots& docs);
 
     /// Handler for textDocument/definition request
     langsvr::lsp::TextDocumentDefinitionRequest::ResultType handle_definition(
-        const langsvr::lsp::TextDocumentDefinitionRequest& req);
+        const langsvr::lsp::TextDocumentDefinitionRequest& req,
+        const DocumentSnapshots& docs);
 
     /// Handler for textDocument/references request
     langsvr::lsp::TextDocumentReferencesRequest::ResultType handle_references(
-        const langsvr::lsp::TextDocumentReferencesRequest& req);
+        const langsvr::lsp::TextDocumentReferencesRequest& req,
+        const DocumentSnapshots& docs, const CancellationToken& cancel);
 
     /// Handler for textDocument/completion request
     langsvr::lsp::TextDocumentCompletionRequest::ResultType handle_completion(
-        const langsvr::lsp::TextDocumentCompletionRequest& req);
+        const langsvr::lsp::TextDocumentCompletionRequest& req,
+        const DocumentSnapshots& docs, const CancellationToken& cancel);
 
     /// Handler for textDocument/documentSymbol request
     langsvr::lsp::TextDocumentDocumentSymbolRequest::ResultType
     handle_document_symbol(
-        const langsvr::lsp::TextDocumentDocumentSymbolRequest& req);
+        const langsvr::lsp::TextDocumentDocumentSymbolRequest& req,
+        const DocumentSnapshots& docs);
 
     /// Handler for textDocument/signatureHelp request
     langsvr::lsp::TextDocumentSignatureHelpRequest::ResultType
     handle_signature_help(
-        const langsvr::lsp::TextDocumentSignatureHelpRequest& req);
+        const langsvr::lsp::TextDocumentSignatureHelpRequest& req,
+        const DocumentSnapshots& docs);
 
     /// Handler for workspace/symbol request
     langsvr::lsp::WorkspaceSymbolRequest::ResultType handle_workspace_symbol(
-        const langsvr::lsp::WorkspaceSymbolRequest& req);
+        const langsvr::lsp::WorkspaceSymbolRequest& req,
+        const DocumentSnapshots& docs, const CancellationToken& cancel);
 
     /// Publish diagnostics for a document
     void publish_diagnostics(const Cpp2Document& doc);
 
+    /// Build a range starting at the 0-based position in `doc` that spans
+    /// the identifier there, or a single character when the document isn't
+    /// open (`doc` is null) or has no identifier at that position
+    auto make_range(const Cpp2Document* doc, int line, int col) const
+        -> langsvr::lsp::Range;
+
+    /// Convert a 0-based line and byte column in `doc` to a position in the
+    /// negotiated encoding; columns in documents that aren't open (`doc` is
+    /// null) are passed through unchanged
+    auto make_position(const Cpp2Document* doc, int line, int col) const
+        -> langsvr::lsp::Position;
+
+    /// Snapshots of the open documents, for answering requests off the main
+    /// thread; only documents changed since the last call are copied
+    /// Called with m_mutex held
+    auto document_snapshots() -> std::shared_ptr<const DocumentSnapshots>;
+
+    /// Priority of a read-only request: Interactive for one on the active
+    /// document or on none (workspace/symbol), Query for the others
+    /// Called with m_mutex held
+    auto request_priority(const langsvr::json::Value& request) const
+        -> TaskPriority;
+
+    /// Queue one message for the client; called from several threads
+    auto send_message(std::string_view message)
+        -> langsvr::Result<langsvr::SuccessType>;
+
+    /// Send a response from a request worker, logging a failure
+    void send_response(std::string_view response);
+
+    /// Convert the column of a client position to a byte column in `doc`
+    auto byte_column(const Cpp2Document& doc,
+                     const langsvr::lsp::Position& pos) const -> int;
+
+    /// Re-parse a document on the reparse worker thread and, if no newer
+    /// edit arrived meanwhile, refresh its index entry and diagnostics
+    void reparse_in_background(const std::string& uri);
+
+    /// Abandon the background parse of `uri` in flight, if any, as an edit
+    /// made its text stale; the document keeps its last parse meanwhile
+    /// Called with m_mutex held
+    void cancel_reparse(const std::string& uri);
+
+    /// Load the index cache and index stale workspace files on the indexing
+    /// thread, merging results in batches so requests are answered from the
+    /// partial index meanwhile
+    void index_workspace();
+
+    /// Stop background indexing after the batch in flight and wait for it
+    void stop_indexing();
+
+    /// Write the index cache as a Background task and wait for it
+    /// Called without m_mutex; only index writers wait for the write
+    void save_index_cache();
+
+    /// Watch the workspace for changes made outside the editor, with
+    /// inotify or, failing that, by asking the client to report them
+    void watch_workspace();
+
+    /// Re-index changed files and drop removed ones, for a debounced batch
+    /// of changes to files that aren't open
+    void apply_file_changes(std::vector<FileChange> changes);
+
   private:
-    StdinReader m_reader;
-    StdoutWriter m_writer;
+    /// Declared first so that anything still sending from the threads below
+    /// has its messages written
+    MessageWriter m_writer;
+    MessageReader m_reader;
     langsvr::Session m_session;
 
     bool m_initialized{false};
@@ -126,6 +207,84 @@ namespace cpp2ls {
 
     /// Workspace root path
     std::string m_workspace_root;
+
+    /// Unit of position columns agreed on with the client in initialize
+    PositionEncoding m_position_encoding{PositionEncoding::Utf16};
+
+    /// Whether the client accepts server-initiated work done progress
+    bool m_work_done_progress{false};
+
+    /// Whether the client lets us register for workspace/didChangeWatchedFiles
+    bool m_watched_files_registration{false};
+
+    /// Whether background indexing is still running
+    bool m_indexing{false};
+
+    /// The document edited or opened last, whose requests come first
+    std::string m_active_uri;
+
+    /// Files to index ahead of the rest, such as those included by newly
+    /// opened documents; drained by the indexing thread
+    std::vector<std::filesystem::path> m_index_promoted;
+
+    /// Guards the documents, index and session against the reparse worker
+    std::mutex m_mutex;
+
+    /// Guards the index against the request workers, which read it without
+    /// m_mutex; the index is only written with both held
+    std::shared_mutex m_index_mutex;
+
+    /// Serializes index cache writes, which only share m_index_mutex
+    std::mutex m_cache_mutex;
+
+    /// Latest result of document_snapshots(); guarded by m_mutex
+    std::shared_ptr<const DocumentSnapshots> m_snapshots;
+
+    /// Debounced background re-parsing of edited documents, run on the pool
+    /// so it yields to requests on the active document
+    /// Its worker submits to m_pool, which is destroyed first; ~Server stops
+    /// it explicitly before any member goes away
+    ReparseScheduler m_reparse{[this](const std::string& uri) {
+      TaskGroup parse{m_pool, TaskPriority::Diagnostics};
+      parse.submit([this, &uri] { reparse_in_background(uri); });
+    }};
+
+    /// The background parse in flight and its token; guarded by m_mutex
+    std::string m_reparse_uri;
+    CancellationToken m_reparse_cancel;
+
+    /// Documents whose last background parse was cancelled; their next one
+    /// is left to finish, so typing without pause still refreshes them
+    /// Guarded by m_mutex
+    std::unordered_set<std::string> m_reparse_starved;
+
+    /// Workspace indexing, started once the client is initialized
+    std::thread m_indexer;
+    /// Cancelled on shutdown; indexing stops without finishing its batch
+    CancellationToken m_stop_indexing{CancellationToken::create()};
+
+    /// Debounced re-indexing of files changed on disk
+    FileChangeQueue m_file_changes{[this](std::vector<FileChange> changes) {
+      apply_file_changes(std::move(changes));
+    }};
+
+    /// Source of on-disk changes; declared after the queue it feeds
+    FileWatcher m_watcher{
+        [this](const std::filesystem::path& path, FileChangeKind kind) {
+          m_file_changes.push(path, kind);
+        }};
+
+    /// Read-only requests, answered on workers from document snapshots and
+    /// the index
+    RequestDispatcher<std::shared_ptr<const DocumentSnapshots>> m_queries{
+        [this](std::string_view response) { send_response(response); },
+        m_pool};
+
+    /// Workers shared by requests, re-parses and indexing, most urgent task
+    /// first; one worker is kept from Background work so requests never
+    /// wait for a whole indexing task
+    /// Declared last so queued tasks finish before what they use goes away
+    WorkStealingPool m_pool{std::thread::hardware_concurrency(), 1};
   };
 
 }  // namespace cpp2ls
@@ -0,0 +1,16 @@
+#ifndef CPP2LS_SOURCE_POSITION_H
+#define CPP2LS_SOURCE_POSITION_H
+
+namespace cpp2ls {
+
+  /// A 1-based (line, column) position, as cppfront reports them
+  struct SourcePosition {
+    int line{0};
+    int column{0};
+
+    auto operator<=>(const SourcePosition&) const = default;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_SOURCE_POSITION_H
@@ -0,0 +1,27 @@
+#ifndef CPP2LS_STRING_HASH_H
+#define CPP2LS_STRING_HASH_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace cpp2ls {
+
+  /// Hash that lets string-keyed maps be probed with a string_view
+  struct StringHash {
+    using is_transparent = void;
+    auto operator()(std::string_view text) const -> std::size_t {
+      return std::hash<std::string_view>{}(text);
+    }
+  };
+
+  /// Map from strings to `T` that can be probed without building a string
+  template <typename T>
+  using StringMap
+      = std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_STRING_HASH_H
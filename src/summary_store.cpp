@@ -0,0 +1,180 @@
+#include "summary_store.h"
+
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include "binary_io.h"
+#include "content_hash.h"
+
+namespace cpp2ls {
+
+  namespace {
+    // Entry layout; bump the format whenever it, or what documents extract,
+    // changes
+    constexpr std::uint64_t kSummaryMagic = 0x4d53534c32505043;  // "CPP2LSSM"
+    constexpr std::uint32_t kSummaryFormat = 1;
+    constexpr std::uint32_t kByteOrderMark = 0x01020304;
+
+    // Summaries depend on how cppfront parses, so its version is part of
+    // the key as well
+    constexpr const char* kCppfrontVersion =
+#include "version.info"
+        " "
+#include "build.info"
+        ;
+
+    /// Directory name for summaries of this build
+    auto version_key() -> std::string {
+      auto version = std::format("cpp2ls {} format {} cppfront {}",
+                                 CPP2LS_VERSION, kSummaryFormat,
+                                 kCppfrontVersion);
+      return std::format("{:016x}", content_hash(version));
+    }
+  }  // namespace
+
+  SummaryStore::SummaryStore(std::filesystem::path dir) {
+    if (!dir.empty()) {
+      m_dir = std::move(dir) / "summaries" / version_key();
+    }
+  }
+
+  auto SummaryStore::default_dir() -> std::filesystem::path {
+    if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache) {
+      return std::filesystem::path(cache) / "cpp2ls";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+      return std::filesystem::path(home) / ".cache" / "cpp2ls";
+    }
+    return {};
+  }
+
+  bool SummaryStore::enabled() const { return !m_dir.empty(); }
+
+  auto SummaryStore::entry_path(std::uint64_t content_hash) const
+      -> std::filesystem::path {
+    // Fan out by the first byte so no directory grows too large
+    auto name = std::format("{:016x}", content_hash);
+    return m_dir / name.substr(0, 2) / (name + ".bin");
+  }
+
+  auto SummaryStore::load(std::uint64_t content_hash,
+                          const std::string& uri) const
+      -> std::optional<FileSummary> {
+    if (!enabled()) {
+      return std::nullopt;
+    }
+
+    MappedFile file;
+    if (!file.open(entry_path(content_hash))) {
+      return std::nullopt;
+    }
+
+    try {
+      BinaryReader in(file.bytes());
+      if (in.read<std::uint64_t>() != kSummaryMagic
+          || in.read<std::uint32_t>() != kSummaryFormat
+          || in.read<std::uint32_t>() != kByteOrderMark
+          || in.read<std::uint64_t>() != content_hash) {
+        return std::nullopt;
+      }
+
+      FileSummary summary;
+      auto symbol_count = in.read<std::uint64_t>();
+      for (std::uint64_t i = 0; i < symbol_count; ++i) {
+        IndexedSymbol symbol;
+        symbol.name = in.read_string();
+        symbol.kind = in.read<SymbolKind>();
+        if (symbol.kind > SymbolKind::Alias) {
+          throw std::runtime_error("bad symbol kind");
+        }
+        symbol.signature = in.read_string();
+        symbol.file_uri = uri;
+        symbol.line = in.read<std::int32_t>();
+        symbol.column = in.read<std::int32_t>();
+        summary.symbols.push_back(std::move(symbol));
+      }
+
+      auto occurrence_count = in.read<std::uint64_t>();
+      for (std::uint64_t i = 0; i < occurrence_count; ++i) {
+        IndexedOccurrences occurrences;
+        occurrences.name = in.read_string();
+        occurrences.file_uri = uri;
+        in.read_array(occurrences.positions);
+        summary.occurrences.push_back(std::move(occurrences));
+      }
+
+      if (!in.at_end()) {
+        throw std::runtime_error("trailing data");
+      }
+      return summary;
+
+    } catch (const std::exception&) {
+      // A truncated or foreign entry; the file is parsed and the entry
+      // rewritten
+      return std::nullopt;
+    }
+  }
+
+  void SummaryStore::store(
+      std::uint64_t content_hash, std::span<const IndexedSymbol> symbols,
+      std::span<const IndexedOccurrences> occurrences) const {
+    if (!enabled()) {
+      return;
+    }
+
+    auto path = entry_path(content_hash);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (ec) {
+      return;
+    }
+
+    // Other servers may write the same entry at the same time; each writes
+    // its own temporary file, and whichever rename lands last wins with
+    // identical contents
+    auto temp_path = path;
+    temp_path += std::format(".{:08x}.tmp", std::random_device{}());
+    {
+      std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+      if (!file) {
+        return;
+      }
+
+      BinaryWriter out(file);
+      out.write(kSummaryMagic);
+      out.write(kSummaryFormat);
+      out.write(kByteOrderMark);
+      out.write(content_hash);
+
+      out.write(static_cast<std::uint64_t>(symbols.size()));
+      for (const auto& symbol : symbols) {
+        out.write_string(symbol.name);
+        out.write(symbol.kind);
+        out.write_string(symbol.signature);
+        out.write(static_cast<std::int32_t>(symbol.line));
+        out.write(static_cast<std::int32_t>(symbol.column));
+      }
+
+      out.write(static_cast<std::uint64_t>(occurrences.size()));
+      for (const auto& entry : occurrences) {
+        out.write_string(entry.name);
+        out.write_array(std::span(entry.positions));
+      }
+
+      if (!file.flush()) {
+        file.close();
+        std::filesystem::remove(temp_path, ec);
+        return;
+      }
+    }
+
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+      std::filesystem::remove(temp_path, ec);
+    }
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,65 @@
+#ifndef CPP2LS_SUMMARY_STORE_H
+#define CPP2LS_SUMMARY_STORE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "index.h"
+
+namespace cpp2ls {
+
+  /// What a file contributes to the index, independent of where it lives
+  struct FileSummary {
+    std::vector<IndexedSymbol> symbols;
+    std::vector<IndexedOccurrences> occurrences;
+  };
+
+  /// Symbol summaries of file contents, shared by every workspace on the
+  /// machine
+  ///
+  /// Entries are addressed by content_hash() of the file and live in a
+  /// directory named after the cpp2ls and cppfront versions, so identical
+  /// files in other worktrees or checkouts are indexed without parsing, and
+  /// a new version never reads summaries an older one extracted. Each entry
+  /// is written to a temporary file and renamed into place, so concurrent
+  /// servers can share the store without locking.
+  class SummaryStore {
+  public:
+    /// A store that never finds anything and never writes
+    SummaryStore() = default;
+
+    /// A store rooted at `dir`; created on the first store()
+    explicit SummaryStore(std::filesystem::path dir);
+
+    /// `$XDG_CACHE_HOME/cpp2ls`, else `~/.cache/cpp2ls`; empty if neither
+    /// variable is set
+    static auto default_dir() -> std::filesystem::path;
+
+    /// False for a store without a directory
+    bool enabled() const;
+
+    /// Summary of the content hashed to `content_hash`, with `uri` filled
+    /// in as the file of its symbols and occurrences
+    /// Thread-safe; returns nothing if there is no valid entry
+    auto load(std::uint64_t content_hash, const std::string& uri) const
+        -> std::optional<FileSummary>;
+
+    /// Record the summary of the content hashed to `content_hash`
+    /// Thread-safe; failures only cost a later parse, so they're ignored
+    void store(std::uint64_t content_hash,
+               std::span<const IndexedSymbol> symbols,
+               std::span<const IndexedOccurrences> occurrences) const;
+
+  private:
+    auto entry_path(std::uint64_t content_hash) const -> std::filesystem::path;
+
+    std::filesystem::path m_dir;  // Versioned; empty if disabled
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_SUMMARY_STORE_H
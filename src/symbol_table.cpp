@@ -0,0 +1,362 @@
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <stdexcept>
+
+#include "binary_io.h"
+
+namespace cpp2ls {
+
+  auto StringPool::intern(std::string_view text) -> Id {
+    if ((size() + 1) * 2 > m_slots.size()) {
+      grow();
+    }
+
+    auto slot = slot_of(text);
+    if (m_slots[slot] != kEmptySlot) {
+      return m_slots[slot];
+    }
+
+    auto id = static_cast<Id>(size());
+    m_chars.append(text);
+    m_offsets.push_back(static_cast<std::uint32_t>(m_chars.size()));
+    m_slots[slot] = id;
+    return id;
+  }
+
+  auto StringPool::find(std::string_view text) const -> std::optional<Id> {
+    if (m_slots.empty()) {
+      return std::nullopt;
+    }
+    auto id = m_slots[slot_of(text)];
+    if (id == kEmptySlot) {
+      return std::nullopt;
+    }
+    return id;
+  }
+
+  auto StringPool::view(Id id) const -> std::string_view {
+    return std::string_view(m_chars).substr(
+        m_offsets[id], m_offsets[id + 1] - m_offsets[id]);
+  }
+
+  auto StringPool::size() const -> std::size_t {
+    return m_offsets.size() - 1;
+  }
+
+  void StringPool::clear() {
+    m_chars.clear();
+    m_offsets.assign(1, 0);
+    m_slots.clear();
+  }
+
+  void StringPool::write(BinaryWriter& out) const {
+    out.write_string(m_chars);
+    out.write_array(std::span(m_offsets));
+    out.write_array(std::span(m_slots));
+  }
+
+  void StringPool::read(BinaryReader& in) {
+    clear();
+    m_chars = in.read_string();
+    in.read_array(m_offsets);
+    in.read_array(m_slots);
+
+    // Everything view() and slot_of() index with must be in range, and
+    // the table must have an empty slot for probing to stop at
+    bool valid = !m_offsets.empty() && m_offsets.front() == 0
+                 && m_offsets.back() == m_chars.size()
+                 && std::ranges::is_sorted(m_offsets);
+    if (valid && !m_slots.empty()) {
+      auto used = std::ranges::count_if(
+          m_slots, [](Id id) { return id != kEmptySlot; });
+      valid = std::has_single_bit(m_slots.size())
+              && static_cast<std::size_t>(used) == size()
+              && size() * 2 <= m_slots.size()
+              && std::ranges::all_of(m_slots, [&](Id id) {
+                   return id == kEmptySlot || id < size();
+                 });
+    } else if (valid) {
+      valid = size() == 0;
+    }
+    if (!valid) {
+      clear();
+      throw std::runtime_error("corrupt string pool");
+    }
+  }
+
+  auto StringPool::slot_of(std::string_view text) const -> std::size_t {
+    // Linear probing; the table is never full, so this terminates
+    auto mask = m_slots.size() - 1;
+    auto slot = std::hash<std::string_view>{}(text) & mask;
+    while (m_slots[slot] != kEmptySlot && view(m_slots[slot]) != text) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  void StringPool::grow() {
+    m_slots.assign(std::max<std::size_t>(16, m_slots.size() * 2), kEmptySlot);
+    for (Id id = 0; id < size(); ++id) {
+      m_slots[slot_of(view(id))] = id;
+    }
+  }
+
+  namespace {
+    /// Removing files compacts the pools once at least this many of their
+    /// strings, and at least half of them, are unused
+    constexpr std::size_t kCompactMinimum = 1024;
+  }  // namespace
+
+  void SymbolTable::add_file(std::string_view uri,
+                             std::span<const IndexedSymbol> symbols) {
+    // A URI without symbols would only be an unused string
+    if (symbols.empty()) {
+      return;
+    }
+
+    auto uri_id = m_uris.intern(uri);
+    if (uri_id >= m_by_uri.size()) {
+      m_by_uri.resize(uri_id + 1);
+    }
+
+    for (const auto& sym : symbols) {
+      auto id = static_cast<SymbolId>(size());
+      auto name_id = m_names.intern(sym.name);
+      if (name_id >= m_by_name.size()) {
+        m_by_name.resize(name_id + 1);
+      }
+
+      auto signature_id = m_signatures.intern(sym.signature);
+      add_ref(m_name_refs, name_id);
+      add_ref(m_uri_refs, uri_id);
+      add_ref(m_signature_refs, signature_id);
+
+      m_name.push_back(name_id);
+      m_uri.push_back(uri_id);
+      m_signature.push_back(signature_id);
+      m_kind.push_back(sym.kind);
+      m_line.push_back(sym.line);
+      m_column.push_back(sym.column);
+
+      m_by_name[name_id].push_back(id);
+      m_by_uri[uri_id].push_back(id);
+    }
+  }
+
+  void SymbolTable::remove_file(std::string_view uri) {
+    auto uri_id = m_uris.find(uri);
+    if (!uri_id) {
+      return;
+    }
+
+    // Highest rows first, so the row moved into a freed slot is never one
+    // of this file's
+    auto rows = std::move(m_by_uri[*uri_id]);
+    m_by_uri[*uri_id].clear();
+    std::ranges::sort(rows, std::greater<>{});
+    for (auto id : rows) {
+      remove_row(id);
+    }
+
+    auto pooled = m_names.size() + m_uris.size() + m_signatures.size();
+    if (m_unused >= kCompactMinimum && m_unused * 2 >= pooled) {
+      compact();
+    }
+  }
+
+  void SymbolTable::remove_row(SymbolId id) {
+    auto& same_name = m_by_name[m_name[id]];
+    same_name.erase(std::ranges::find(same_name, id));
+    release(m_name_refs, m_name[id]);
+    release(m_uri_refs, m_uri[id]);
+    release(m_signature_refs, m_signature[id]);
+
+    auto last = static_cast<SymbolId>(size() - 1);
+    if (id != last) {
+      m_name[id] = m_name[last];
+      m_uri[id] = m_uri[last];
+      m_signature[id] = m_signature[last];
+      m_kind[id] = m_kind[last];
+      m_line[id] = m_line[last];
+      m_column[id] = m_column[last];
+      std::ranges::replace(m_by_name[m_name[id]], last, id);
+      std::ranges::replace(m_by_uri[m_uri[id]], last, id);
+    }
+
+    m_name.pop_back();
+    m_uri.pop_back();
+    m_signature.pop_back();
+    m_kind.pop_back();
+    m_line.pop_back();
+    m_column.pop_back();
+  }
+
+  void SymbolTable::add_ref(std::vector<std::uint32_t>& refs,
+                            StringPool::Id id) {
+    // Pools hand out ids in order, so an id past the end is a new string
+    if (id >= refs.size()) {
+      refs.resize(id + 1);
+    } else if (refs[id] == 0) {
+      --m_unused;
+    }
+    ++refs[id];
+  }
+
+  void SymbolTable::release(std::vector<std::uint32_t>& refs,
+                            StringPool::Id id) {
+    if (--refs[id] == 0) {
+      ++m_unused;
+    }
+  }
+
+  void SymbolTable::compact() {
+    // Map each used string to its id in a fresh pool, in id order
+    auto repack = [](StringPool& pool, std::vector<std::uint32_t>& refs) {
+      StringPool packed;
+      std::vector<StringPool::Id> new_ids(pool.size(), 0);
+      std::vector<std::uint32_t> packed_refs;
+      for (StringPool::Id id = 0; id < pool.size(); ++id) {
+        if (refs[id] > 0) {
+          new_ids[id] = packed.intern(pool.view(id));
+          packed_refs.push_back(refs[id]);
+        }
+      }
+      pool = std::move(packed);
+      refs = std::move(packed_refs);
+      return new_ids;
+    };
+    auto new_names = repack(m_names, m_name_refs);
+    auto new_uris = repack(m_uris, m_uri_refs);
+    auto new_signatures = repack(m_signatures, m_signature_refs);
+
+    for (SymbolId id = 0; id < size(); ++id) {
+      m_name[id] = new_names[m_name[id]];
+      m_uri[id] = new_uris[m_uri[id]];
+      m_signature[id] = new_signatures[m_signature[id]];
+    }
+
+    // Move the posting lists rather than rebuilding them, which keeps
+    // their order
+    auto move_lists = [](std::vector<std::vector<SymbolId>>& lists,
+                         const std::vector<StringPool::Id>& new_ids,
+                         std::size_t count) {
+      std::vector<std::vector<SymbolId>> moved(count);
+      for (std::size_t id = 0; id < lists.size(); ++id) {
+        if (!lists[id].empty()) {
+          moved[new_ids[id]] = std::move(lists[id]);
+        }
+      }
+      lists = std::move(moved);
+    };
+    move_lists(m_by_name, new_names, m_names.size());
+    move_lists(m_by_uri, new_uris, m_uris.size());
+
+    m_unused = 0;
+  }
+
+  void SymbolTable::clear() { *this = SymbolTable{}; }
+
+  auto SymbolTable::find(std::string_view name) const
+      -> std::span<const SymbolId> {
+    auto name_id = m_names.find(name);
+    if (!name_id) {
+      return {};
+    }
+    return m_by_name[*name_id];
+  }
+
+  auto SymbolTable::in_file(std::string_view uri) const
+      -> std::span<const SymbolId> {
+    auto uri_id = m_uris.find(uri);
+    if (!uri_id) {
+      return {};
+    }
+    return m_by_uri[*uri_id];
+  }
+
+  auto SymbolTable::ids() const -> std::ranges::iota_view<SymbolId, SymbolId> {
+    return std::views::iota(SymbolId{0}, static_cast<SymbolId>(size()));
+  }
+
+  auto SymbolTable::size() const -> std::size_t { return m_name.size(); }
+
+  void SymbolTable::write(BinaryWriter& out) const {
+    if (m_unused > 0) {
+      auto compacted = *this;
+      compacted.compact();
+      compacted.write(out);
+      return;
+    }
+
+    m_names.write(out);
+    m_uris.write(out);
+    m_signatures.write(out);
+    out.write_array(std::span(m_name));
+    out.write_array(std::span(m_uri));
+    out.write_array(std::span(m_signature));
+    out.write_array(std::span(m_kind));
+    out.write_array(std::span(m_line));
+    out.write_array(std::span(m_column));
+  }
+
+  void SymbolTable::read(BinaryReader& in) {
+    clear();
+    m_names.read(in);
+    m_uris.read(in);
+    m_signatures.read(in);
+    in.read_array(m_name);
+    in.read_array(m_uri);
+    in.read_array(m_signature);
+    in.read_array(m_kind);
+    in.read_array(m_line);
+    in.read_array(m_column);
+
+    auto rows = m_name.size();
+    auto in_pool = [](const auto& ids, const StringPool& pool) {
+      return std::ranges::all_of(
+          ids, [&](StringPool::Id id) { return id < pool.size(); });
+    };
+    bool valid = m_uri.size() == rows && m_signature.size() == rows
+                 && m_kind.size() == rows && m_line.size() == rows
+                 && m_column.size() == rows && in_pool(m_name, m_names)
+                 && in_pool(m_uri, m_uris)
+                 && in_pool(m_signature, m_signatures)
+                 && std::ranges::all_of(m_kind, [](SymbolKind kind) {
+                      return kind <= SymbolKind::Alias;
+                    });
+    if (!valid) {
+      clear();
+      throw std::runtime_error("corrupt symbol table");
+    }
+
+    // The posting lists and counts are cheaper to rebuild than to validate
+    m_by_name.resize(m_names.size());
+    m_by_uri.resize(m_uris.size());
+    m_name_refs.resize(m_names.size());
+    m_uri_refs.resize(m_uris.size());
+    m_signature_refs.resize(m_signatures.size());
+    for (SymbolId id = 0; id < rows; ++id) {
+      m_by_name[m_name[id]].push_back(id);
+      m_by_uri[m_uri[id]].push_back(id);
+      ++m_name_refs[m_name[id]];
+      ++m_uri_refs[m_uri[id]];
+      ++m_signature_refs[m_signature[id]];
+    }
+    for (const auto* refs : {&m_name_refs, &m_uri_refs, &m_signature_refs}) {
+      m_unused += std::ranges::count(*refs, 0u);
+    }
+  }
+
+  auto SymbolTable::get(SymbolId id) const -> SymbolView {
+    return {m_names.view(m_name[id]),
+            m_kind[id],
+            m_signatures.view(m_signature[id]),
+            m_uris.view(m_uri[id]),
+            m_line[id],
+            m_column[id]};
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,177 @@
+#ifndef CPP2LS_SYMBOL_TABLE_H
+#define CPP2LS_SYMBOL_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpp2ls {
+
+  class BinaryReader;
+  class BinaryWriter;
+
+  /// Symbol kind for indexed symbols
+  enum class SymbolKind : std::uint8_t {
+    Function,
+    Type,
+    Namespace,
+    Variable,
+    Alias
+  };
+
+  /// Indexed symbol information, as produced by a document
+  struct IndexedSymbol {
+    std::string name;  // Symbol name
+    SymbolKind kind{SymbolKind::Function};
+    std::string signature;  // For functions: parameter list
+    std::string file_uri;   // URI of the file containing the symbol
+    int line{0};            // 0-based line number
+    int column{0};          // 0-based column number
+  };
+
+  /// Read-only view of a symbol stored in a SymbolTable
+  /// The strings stay valid until the table is next modified
+  struct SymbolView {
+    std::string_view name;
+    SymbolKind kind{SymbolKind::Function};
+    std::string_view signature;
+    std::string_view file_uri;
+    int line{0};
+    int column{0};
+  };
+
+  /// Index of a symbol in a SymbolTable
+  using SymbolId = std::uint32_t;
+
+  /// Deduplicated strings addressed by dense 32-bit ids
+  ///
+  /// The characters of all strings are stored back to back, and an
+  /// open-addressing table of ids finds a string again by its text. A
+  /// string that occurs many times is stored once.
+  class StringPool {
+  public:
+    using Id = std::uint32_t;
+
+    /// Id of `text`, adding it if it is new
+    auto intern(std::string_view text) -> Id;
+
+    /// Id of `text`, if it was interned
+    auto find(std::string_view text) const -> std::optional<Id>;
+
+    /// The string with id `id`; valid until the next intern()
+    auto view(Id id) const -> std::string_view;
+
+    /// Number of distinct strings
+    auto size() const -> std::size_t;
+
+    void clear();
+
+    /// Write the pool, including its hash table
+    void write(BinaryWriter& out) const;
+
+    /// Restore a pool written by write(); throws std::runtime_error if the
+    /// data is inconsistent
+    void read(BinaryReader& in);
+
+  private:
+    static constexpr Id kEmptySlot = ~Id{0};
+
+    /// Slot holding `text`, or the empty slot where it would go
+    auto slot_of(std::string_view text) const -> std::size_t;
+
+    /// Double the table and reinsert every id
+    void grow();
+
+    std::string m_chars;  // All strings, back to back
+    std::vector<std::uint32_t> m_offsets{0};  // String i: [i], [i + 1]
+    std::vector<Id> m_slots;  // Power-of-two sized, at most half full
+  };
+
+  /// Symbols of the whole workspace, stored column by column
+  ///
+  /// Names, URIs and signatures are interned, so each symbol is a row of
+  /// small integers. Rows are kept dense: removing one moves the last row
+  /// into its place, so ids and posting lists are in no particular order.
+  /// Symbols are found by name through a posting list per name id, and by
+  /// file through a list per URI id.
+  ///
+  /// Pool strings are counted by the rows using them. Strings left unused
+  /// by removed files are dropped by compacting the pools once they make up
+  /// half of them, and are never written out.
+  class SymbolTable {
+  public:
+    /// Add the symbols of a file; their `file_uri` is ignored
+    void add_file(std::string_view uri,
+                  std::span<const IndexedSymbol> symbols);
+
+    /// Remove every symbol of a file
+    void remove_file(std::string_view uri);
+
+    void clear();
+
+    /// Symbols named `name`, in unspecified order
+    auto find(std::string_view name) const -> std::span<const SymbolId>;
+
+    /// Symbols of the file `uri`, in unspecified order
+    auto in_file(std::string_view uri) const -> std::span<const SymbolId>;
+
+    /// Ids of all symbols; after removals these are not in insertion order
+    auto ids() const -> std::ranges::iota_view<SymbolId, SymbolId>;
+
+    auto size() const -> std::size_t;
+
+    /// A symbol by id
+    auto get(SymbolId id) const -> SymbolView;
+
+    /// Write the pools and columns, each as one block, leaving out unused
+    /// strings
+    void write(BinaryWriter& out) const;
+
+    /// Restore a table written by write(); throws std::runtime_error if
+    /// the data is inconsistent
+    void read(BinaryReader& in);
+
+  private:
+    /// Remove one row, moving the last row into its place
+    void remove_row(SymbolId id);
+
+    /// Count one more row using string `id` of a pool
+    void add_ref(std::vector<std::uint32_t>& refs, StringPool::Id id);
+
+    /// Count one less row using string `id` of a pool
+    void release(std::vector<std::uint32_t>& refs, StringPool::Id id);
+
+    /// Rebuild the pools without their unused strings, renumbering the ids
+    /// in the columns and posting lists
+    void compact();
+
+    StringPool m_names;
+    StringPool m_uris;
+    StringPool m_signatures;
+
+    // Rows using each string, indexed by pool id
+    std::vector<std::uint32_t> m_name_refs;
+    std::vector<std::uint32_t> m_uri_refs;
+    std::vector<std::uint32_t> m_signature_refs;
+    std::size_t m_unused{0};  // Strings with no rows, over all pools
+
+    // Columns, one entry per symbol
+    std::vector<StringPool::Id> m_name;
+    std::vector<StringPool::Id> m_uri;
+    std::vector<StringPool::Id> m_signature;
+    std::vector<SymbolKind> m_kind;
+    std::vector<std::int32_t> m_line;
+    std::vector<std::int32_t> m_column;
+
+    std::vector<std::vector<SymbolId>> m_by_name;  // Indexed by name id
+    std::vector<std::vector<SymbolId>> m_by_uri;   // Indexed by URI id
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_SYMBOL_TABLE_H
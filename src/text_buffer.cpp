@@ -0,0 +1,178 @@
+#include "text_buffer.h"
+
+#include <algorithm>
+
+namespace cpp2ls {
+
+  namespace {
+    // Fold the piece list back into a single original buffer once it grows
+    // past this size, so piece lookups stay cheap on long editing sessions
+    constexpr std::size_t kMaxPieces = 256;
+  }  // namespace
+
+  TextBuffer::TextBuffer(std::string text) { assign(std::move(text)); }
+
+  void TextBuffer::assign(std::string text) {
+    m_original = std::make_shared<const std::string>(std::move(text));
+    m_add.clear();
+    m_pieces.clear();
+    if (!m_original->empty()) {
+      m_pieces.push_back({Source::Original, 0, m_original->size()});
+    }
+    m_size = m_original->size();
+
+    m_lines = std::make_shared<LineIndex>(*m_original);
+
+    m_flat.reset();
+  }
+
+  void TextBuffer::replace(std::size_t start, std::size_t end,
+                           std::string_view text) {
+    start = std::min(start, m_size);
+    end = std::clamp(end, start, m_size);
+    if (start == end && text.empty()) {
+      return;
+    }
+
+    if (m_lines.use_count() > 1) {
+      m_lines = std::make_shared<LineIndex>(*m_lines);
+    }
+    m_lines->replace(start, end, text);
+
+    Piece inserted{Source::Add, m_add.size(), text.size()};
+    m_add.append(text);
+
+    std::vector<Piece> pieces;
+    pieces.reserve(m_pieces.size() + 2);
+
+    auto push = [&pieces](const Piece& piece) {
+      if (piece.length == 0) {
+        return;
+      }
+      // Coalesce with the previous piece when it is contiguous in the same
+      // store (the common case for sequential typing)
+      if (!pieces.empty()) {
+        auto& last = pieces.back();
+        if (last.source == piece.source
+            && last.start + last.length == piece.start) {
+          last.length += piece.length;
+          return;
+        }
+      }
+      pieces.push_back(piece);
+    };
+
+    bool placed = false;
+    std::size_t pos = 0;
+    for (const auto& piece : m_pieces) {
+      auto piece_end = pos + piece.length;
+
+      if (piece_end <= start) {
+        push(piece);
+      } else if (pos >= end) {
+        if (!placed) {
+          push(inserted);
+          placed = true;
+        }
+        push(piece);
+      } else {
+        // The piece overlaps the replaced range: keep what lies outside it
+        if (pos < start) {
+          push({piece.source, piece.start, start - pos});
+        }
+        if (!placed) {
+          push(inserted);
+          placed = true;
+        }
+        if (piece_end > end) {
+          push({piece.source, piece.start + (end - pos), piece_end - end});
+        }
+      }
+
+      pos = piece_end;
+    }
+    if (!placed) {
+      push(inserted);
+    }
+
+    m_pieces = std::move(pieces);
+    m_size = m_size - (end - start) + text.size();
+    m_flat.reset();
+
+    if (m_pieces.size() > kMaxPieces) {
+      compact();
+    }
+  }
+
+  void TextBuffer::compact() {
+    // The line index already describes the text
+    m_original = shared_text();
+    m_add.clear();
+    m_pieces.clear();
+    if (!m_original->empty()) {
+      m_pieces.push_back({Source::Original, 0, m_original->size()});
+    }
+    m_flat.reset();
+  }
+
+  auto TextBuffer::piece_data(const Piece& piece) const -> std::string_view {
+    const auto& store = piece.source == Source::Original ? *m_original : m_add;
+    return std::string_view{store}.substr(piece.start, piece.length);
+  }
+
+  auto TextBuffer::offset_of(int line, int col) const -> std::size_t {
+    return m_lines->offset_of(line, col);
+  }
+
+  auto TextBuffer::line(int line) const -> std::string_view {
+    if (line < 0 || line >= line_count()) {
+      return {};
+    }
+
+    auto line_start = m_lines->line_start(line);
+    return text().substr(line_start, m_lines->line_end(line) - line_start);
+  }
+
+  auto TextBuffer::line_count() const -> int { return m_lines->line_count(); }
+
+  auto TextBuffer::size() const -> std::size_t { return m_size; }
+
+  auto TextBuffer::lines() const -> const LineIndex& { return *m_lines; }
+
+  auto TextBuffer::text() const -> std::string_view {
+    if (m_pieces.empty()) {
+      return {};
+    }
+    return *shared_text();
+  }
+
+  auto TextBuffer::snapshot() const -> TextBuffer {
+    TextBuffer copy;
+    copy.m_original = shared_text();
+    if (!copy.m_original->empty()) {
+      copy.m_pieces.push_back({Source::Original, 0, copy.m_original->size()});
+    }
+    copy.m_size = m_size;
+    copy.m_lines = m_lines;
+    return copy;
+  }
+
+  auto TextBuffer::shared_text() const -> std::shared_ptr<const std::string> {
+    // Freshly assigned buffers are served straight from the original store
+    if (m_pieces.size() == 1 && m_pieces.front().source == Source::Original
+        && m_pieces.front().length == m_original->size()) {
+      return m_original;
+    }
+
+    if (!m_flat) {
+      std::string flat;
+      flat.reserve(m_size);
+      for (const auto& piece : m_pieces) {
+        flat.append(piece_data(piece));
+      }
+      m_flat = std::make_shared<const std::string>(std::move(flat));
+    }
+    return m_flat;
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,95 @@
+#ifndef CPP2LS_TEXT_BUFFER_H
+#define CPP2LS_TEXT_BUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "line_index.h"
+
+namespace cpp2ls {
+
+  /// Piece-table text buffer for an open document
+  ///
+  /// Edits append the inserted text to an add buffer and splice a piece into
+  /// the piece list, so applying an incremental change costs O(edit + pieces)
+  /// instead of O(file). The line index is patched in place on every edit.
+  /// A contiguous copy of the text is only materialized on demand (e.g. for
+  /// parsing) and cached until the next edit. Snapshots share that copy and
+  /// the line index rather than duplicating them.
+  class TextBuffer {
+  public:
+    TextBuffer() = default;
+    explicit TextBuffer(std::string text);
+
+    /// Replace the whole buffer content
+    void assign(std::string text);
+
+    /// Replace the byte range [start, end) with `text`
+    /// Offsets are clamped to the buffer size
+    void replace(std::size_t start, std::size_t end, std::string_view text);
+
+    /// Convert a 0-based (line, column) position to a byte offset
+    /// Columns past the end of the line are clamped to the line end, lines
+    /// past the end of the buffer map to the buffer size
+    auto offset_of(int line, int col) const -> std::size_t;
+
+    /// Get the text of a 0-based line, without its line terminator
+    auto line(int line) const -> std::string_view;
+
+    /// Number of lines (a trailing newline starts a new, empty line)
+    auto line_count() const -> int;
+
+    /// Total size in bytes
+    auto size() const -> std::size_t;
+
+    /// Line start offsets of the current contents
+    auto lines() const -> const LineIndex&;
+
+    /// Get the full contents as a contiguous view
+    /// The view is valid until the next edit
+    auto text() const -> std::string_view;
+
+    /// Buffer with the current contents that shares this one's text and
+    /// line index; costs a materialization if the text changed since the
+    /// last one. The copy reads without writing to itself, so several
+    /// threads may read it at once
+    auto snapshot() const -> TextBuffer;
+
+  private:
+    /// Which backing store a piece refers to
+    enum class Source { Original, Add };
+
+    /// A run of bytes from one of the backing stores
+    struct Piece {
+      Source source{Source::Original};
+      std::size_t start{0};
+      std::size_t length{0};
+    };
+
+    /// Re-seat the original buffer on the current text and drop all pieces
+    void compact();
+
+    auto piece_data(const Piece& piece) const -> std::string_view;
+
+    /// The contents in one string, materialized if needed
+    auto shared_text() const -> std::shared_ptr<const std::string>;
+
+    std::shared_ptr<const std::string> m_original{
+        std::make_shared<const std::string>()};
+    std::string m_add;
+    std::vector<Piece> m_pieces;
+    std::size_t m_size{0};
+
+    // Shared with snapshots; edits patch a copy while it is shared
+    std::shared_ptr<LineIndex> m_lines{std::make_shared<LineIndex>()};
+
+    // Materialized contents, rebuilt lazily after edits; null while stale
+    mutable std::shared_ptr<const std::string> m_flat;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_TEXT_BUFFER_H
@@ -0,0 +1,219 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <format>
+#include <iostream>
+
+namespace cpp2ls {
+
+  namespace {
+    constexpr auto kBackground
+        = static_cast<std::size_t>(TaskPriority::Background);
+
+    // The pool and deque of the worker running on this thread, if any
+    thread_local const WorkStealingPool* t_pool = nullptr;
+    thread_local std::size_t t_queue = 0;
+
+    /// Decrement `count` unless it is zero; whether it was decremented
+    auto try_decrement(std::atomic<std::size_t>& count) -> bool {
+      auto value = count.load();
+      while (value > 0 && !count.compare_exchange_weak(value, value - 1)) {
+      }
+      return value > 0;
+    }
+  }  // namespace
+
+  WorkStealingPool::WorkStealingPool(unsigned threads, unsigned reserved) {
+    auto count = std::max(threads, 1u);
+    m_background_limit = count > reserved ? count - reserved : 1;
+    for (unsigned i = 0; i < count; ++i) {
+      m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < count; ++i) {
+      m_workers.emplace_back([this, i] { run(i); });
+    }
+  }
+
+  WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+      std::lock_guard lock{m_mutex};
+      m_stopped = true;
+    }
+    m_work_cv.notify_all();
+    for (auto& worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  void WorkStealingPool::submit(Task task, TaskPriority priority) {
+    auto level = static_cast<std::size_t>(priority);
+    auto index = t_pool == this ? t_queue
+                                : m_next_queue.fetch_add(1) % m_queues.size();
+
+    ++m_unfinished;
+    {
+      std::lock_guard lock{m_queues[index]->mutex};
+      m_queues[index]->tasks[level].push_back(std::move(task));
+    }
+
+    // Count the task only once it is in a queue, so a worker that claims
+    // it is sure to find it
+    ++m_queued[level];
+    wake();
+  }
+
+  void WorkStealingPool::wait() {
+    std::unique_lock lock{m_mutex};
+    m_done_cv.wait(lock, [this] { return m_unfinished == 0; });
+  }
+
+  auto WorkStealingPool::size() const -> std::size_t {
+    return m_workers.size();
+  }
+
+  void WorkStealingPool::run(std::size_t index) {
+    t_pool = this;
+    t_queue = index;
+
+    while (true) {
+      auto claimed = claim();
+      if (!claimed) {
+        // Counted as sleeping before checking again, so a submit either
+        // shows up in the check or sees us sleeping and wakes us
+        std::unique_lock lock{m_mutex};
+        ++m_sleeping;
+        m_work_cv.wait(lock, [&] { return (claimed = claim()) || m_stopped; });
+        --m_sleeping;
+        if (!claimed) {
+          return;  // Stopped and drained
+        }
+      }
+      auto priority = *claimed;
+
+      // The claim above guarantees a task is queued somewhere, though
+      // another worker may move ahead of us to the one we look at first
+      std::optional<Task> task;
+      while (!(task = take(index, priority))) {
+        std::this_thread::yield();
+      }
+
+      try {
+        (*task)();
+      } catch (const std::exception& e) {
+        std::cerr << std::format("Worker task failed: {}\n", e.what());
+      }
+
+      if (priority == kBackground) {
+        --m_background_running;
+        wake();  // A held back Background task may start
+      }
+      if (--m_unfinished == 0) {
+        // Notified under the lock, so wait() can't miss it between checking
+        // the count and sleeping
+        std::lock_guard lock{m_mutex};
+        m_done_cv.notify_all();
+      }
+    }
+  }
+
+  auto WorkStealingPool::claim() -> std::optional<std::size_t> {
+    for (std::size_t priority = 0; priority < kBackground; ++priority) {
+      if (try_decrement(m_queued[priority])) {
+        return priority;
+      }
+    }
+
+    // Take a Background slot first, so no more than the limit run at once
+    auto running = m_background_running.load();
+    do {
+      if (running >= m_background_limit) {
+        return std::nullopt;
+      }
+    } while (!m_background_running.compare_exchange_weak(running,
+                                                         running + 1));
+    if (try_decrement(m_queued[kBackground])) {
+      return kBackground;
+    }
+    --m_background_running;
+    return std::nullopt;
+  }
+
+  void WorkStealingPool::wake() {
+    if (m_sleeping == 0) {
+      return;
+    }
+    // Taking the lock orders this after a sleeper's last check
+    {
+      std::lock_guard lock{m_mutex};
+    }
+    m_work_cv.notify_one();
+  }
+
+  auto WorkStealingPool::take(std::size_t index, std::size_t priority)
+      -> std::optional<Task> {
+    {
+      auto& own = m_queues[index]->tasks[priority];
+      std::lock_guard lock{m_queues[index]->mutex};
+      if (!own.empty()) {
+        auto task = std::move(own.back());
+        own.pop_back();
+        return task;
+      }
+    }
+
+    for (std::size_t offset = 1; offset < m_queues.size(); ++offset) {
+      auto& victim = *m_queues[(index + offset) % m_queues.size()];
+      std::lock_guard lock{victim.mutex};
+      auto& tasks = victim.tasks[priority];
+      if (!tasks.empty()) {
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        return task;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  TaskGroup::TaskGroup(WorkStealingPool& pool, TaskPriority priority)
+      : m_pool{pool}, m_priority{priority} {}
+
+  TaskGroup::~TaskGroup() { wait(); }
+
+  void TaskGroup::submit(WorkStealingPool::Task task) {
+    {
+      std::lock_guard lock{m_mutex};
+      ++m_unfinished;
+    }
+    m_pool.submit(
+        [this, task = std::move(task)] {
+          try {
+            task();
+          } catch (...) {
+            finish();
+            throw;
+          }
+          finish();
+        },
+        m_priority);
+  }
+
+  void TaskGroup::wait() {
+    std::unique_lock lock{m_mutex};
+    m_done_cv.wait(lock, [this] { return m_unfinished == 0; });
+  }
+
+  auto TaskGroup::pool() const -> WorkStealingPool& { return m_pool; }
+
+  void TaskGroup::finish() {
+    // Notified under the lock: the waiter may destroy the group as soon as
+    // it can take the lock
+    std::lock_guard lock{m_mutex};
+    if (--m_unfinished == 0) {
+      m_done_cv.notify_all();
+    }
+  }
+
+}  // namespace cpp2ls
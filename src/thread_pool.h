@@ -0,0 +1,141 @@
+#ifndef CPP2LS_THREAD_POOL_H
+#define CPP2LS_THREAD_POOL_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace cpp2ls {
+
+  /// Classes of work sharing a pool, most urgent first
+  enum class TaskPriority {
+    Interactive,  // Requests on the document being edited
+    Diagnostics,  // Re-parses that refresh an edited document's diagnostics
+    Query,        // Requests on other documents
+    Background,   // Indexing, cache writes and analysis of closed files
+  };
+
+  inline constexpr std::size_t kTaskPriorities = 4;
+
+  /// Fixed set of worker threads with one task deque per worker and priority
+  ///
+  /// A worker runs tasks from the back of its own deque and, once that is
+  /// empty, steals from the front of the others'. Batches of uneven tasks
+  /// (one huge file among many small ones) therefore keep every worker busy
+  /// until the batch is done.
+  ///
+  /// Whenever a worker finishes a task it claims the most urgent one queued,
+  /// so urgent work overtakes queued background work at task boundaries;
+  /// running tasks are never interrupted. Claims only touch atomic counts of
+  /// the queued tasks per priority, and taking a task only locks the deques
+  /// looked at; the pool-wide mutex is just for idle workers to sleep on.
+  /// Reserved workers never start Background tasks, which keeps them free
+  /// for urgent work arriving while the others are busy with long ones.
+  class WorkStealingPool {
+  public:
+    using Task = std::function<void()>;
+
+    /// Start `threads` workers (at least one), `reserved` of which don't run
+    /// Background tasks (at least one worker does)
+    explicit WorkStealingPool(
+        unsigned threads = std::thread::hardware_concurrency(),
+        unsigned reserved = 0);
+
+    /// Run the tasks still queued, then stop the workers
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /// Queue a task; a worker queues on its own deque, other threads spread
+    /// tasks over the workers round-robin
+    void submit(Task task, TaskPriority priority = TaskPriority::Background);
+
+    /// Block until every submitted task has finished
+    void wait();
+
+    /// Number of worker threads
+    auto size() const -> std::size_t;
+
+  private:
+    struct Queue {
+      std::mutex mutex;
+      std::array<std::deque<Task>, kTaskPriorities> tasks;  // By priority
+    };
+
+    void run(std::size_t index);
+
+    /// The priority of the most urgent task a worker may start now, counted
+    /// as taken
+    auto claim() -> std::optional<std::size_t>;
+
+    /// Wake a sleeping worker, if there is one
+    void wake();
+
+    /// Pop a `priority` task from the back of queue `index`, or steal one
+    /// from another's front
+    auto take(std::size_t index, std::size_t priority) -> std::optional<Task>;
+
+    std::vector<std::unique_ptr<Queue>> m_queues;  // One per worker
+
+    // Queued and not yet claimed by a worker, by priority
+    std::array<std::atomic<std::size_t>, kTaskPriorities> m_queued{};
+    std::atomic<std::size_t> m_unfinished{0};  // Submitted, not finished
+    std::atomic<std::size_t> m_background_running{0};
+    std::size_t m_background_limit;  // Workers allowed to run Background
+    std::atomic<std::size_t> m_next_queue{0};
+    std::atomic<std::size_t> m_sleeping{0};  // Workers waiting on m_work_cv
+
+    // Only held to sleep, to wake sleepers and to wait for the tasks
+    std::mutex m_mutex;
+    std::condition_variable m_work_cv;  // Signalled when tasks are queued
+    std::condition_variable m_done_cv;  // Signalled when all are finished
+    bool m_stopped{false};              // Guarded by m_mutex
+
+    // Declared last so the state above exists before the workers start
+    std::vector<std::thread> m_workers;
+  };
+
+  /// Tasks submitted to a pool together, at one priority, that can be
+  /// waited for apart from the pool's other work
+  class TaskGroup {
+  public:
+    TaskGroup(WorkStealingPool& pool, TaskPriority priority);
+
+    /// Waits for the tasks, which refer to the group
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /// Queue a task on the pool
+    void submit(WorkStealingPool::Task task);
+
+    /// Block until every task submitted here has finished
+    void wait();
+
+    /// The pool the tasks run on
+    auto pool() const -> WorkStealingPool&;
+
+  private:
+    void finish();
+
+    WorkStealingPool& m_pool;
+    TaskPriority m_priority;
+
+    std::mutex m_mutex;
+    std::condition_variable m_done_cv;
+    std::size_t m_unfinished{0};
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_THREAD_POOL_H
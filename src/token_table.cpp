@@ -0,0 +1,88 @@
+#include "token_table.h"
+
+#include <algorithm>
+
+namespace cpp2ls {
+
+  void TokenTable::build(std::vector<Entry> entries, int first_line,
+                         int last_line) {
+    // Sections are lexed in order, so this is normally already sorted
+    auto before = [](const Entry& a, const Entry& b) {
+      return a.line < b.line || (a.line == b.line && a.column < b.column);
+    };
+    if (!std::is_sorted(entries.begin(), entries.end(), before)) {
+      std::stable_sort(entries.begin(), entries.end(), before);
+    }
+    m_entries = std::move(entries);
+    m_first_line = first_line;
+
+    auto line_count = std::max(last_line - first_line + 1, 0);
+    m_line_starts.resize(line_count + 1);
+    std::size_t index = 0;
+    for (int i = 0; i <= line_count; ++i) {
+      while (index < m_entries.size()
+             && m_entries[index].line < first_line + i) {
+        ++index;
+      }
+      m_line_starts[i] = index;
+    }
+    m_line_starts.back() = m_entries.size();
+  }
+
+  auto TokenTable::at(int line, int col) const -> const cpp2::token* {
+    auto index = lower_bound(line, col + 1);
+    if (index == 0) {
+      return nullptr;
+    }
+
+    // The candidate is the last token starting at or before `col`
+    const auto& entry = m_entries[index - 1];
+    if (entry.line == line && col >= entry.column
+        && col < entry.column + entry.length) {
+      return entry.token;
+    }
+    return nullptr;
+  }
+
+  auto TokenTable::lower_bound(int line, int col) const -> std::size_t {
+    // Narrow the search to the line when it lies inside the section
+    auto first = m_entries.begin();
+    auto last = m_entries.end();
+    auto relative = line - m_first_line;
+    if (relative < 0) {
+      return 0;
+    }
+    if (relative + 1 < static_cast<int>(m_line_starts.size())) {
+      first += m_line_starts[relative];
+      last = m_entries.begin() + m_line_starts[relative + 1];
+      if (first == last) {
+        return first - m_entries.begin();
+      }
+    }
+
+    auto it = std::lower_bound(first, last, std::pair{line, col},
+                               [](const Entry& entry, const auto& pos) {
+                                 return entry.line < pos.first
+                                        || (entry.line == pos.first
+                                            && entry.column < pos.second);
+                               });
+    return it - m_entries.begin();
+  }
+
+  auto TokenTable::identifier_before(std::string_view name, int line,
+                                     int col) const -> const cpp2::token* {
+    // Walk back from the cursor; the first match is the nearest one
+    for (auto index = lower_bound(line, col); index > 0; --index) {
+      const auto& entry = m_entries[index - 1];
+      if (entry.is_identifier && entry.text == name) {
+        return entry.token;
+      }
+    }
+    return nullptr;
+  }
+
+  auto TokenTable::entries() const -> const std::vector<Entry>& {
+    return m_entries;
+  }
+
+}  // namespace cpp2ls
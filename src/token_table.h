@@ -0,0 +1,63 @@
+#ifndef CPP2LS_TOKEN_TABLE_H
+#define CPP2LS_TOKEN_TABLE_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Forward declarations from cppfront
+namespace cpp2 {
+  class token;
+}  // namespace cpp2
+
+namespace cpp2ls {
+
+  /// Position-sorted view of a section's tokens
+  ///
+  /// Built once per parse, this flattens the per-section token vectors of
+  /// cpp2::tokens into one contiguous array of (position, length, token)
+  /// records with a per-line index, so cursor lookups are a line jump plus a
+  /// binary search within the line instead of a walk over every token.
+  /// The records carry everything the lookups need, so the table itself
+  /// never has to look inside a cpp2::token.
+  class TokenTable {
+  public:
+    /// A token and its position, copied out for cache-friendly searching
+    struct Entry {
+      const cpp2::token* token{nullptr};
+      int line{0};    // 1-based
+      int column{0};  // 1-based
+      int length{0};
+      std::string_view text;
+      bool is_identifier{false};
+    };
+
+    /// Index `entries`, which lie on lines [first_line, last_line] (1-based)
+    void build(std::vector<Entry> entries, int first_line, int last_line);
+
+    /// Find the token covering the given position (1-based line and column)
+    auto at(int line, int col) const -> const cpp2::token*;
+
+    /// Index of the first entry at or after the given position, i.e. the
+    /// number of entries that lie before it
+    auto lower_bound(int line, int col) const -> std::size_t;
+
+    /// Find the nearest identifier token named `name` before the position
+    auto identifier_before(std::string_view name, int line, int col) const
+        -> const cpp2::token*;
+
+    /// All entries in position order
+    auto entries() const -> const std::vector<Entry>&;
+
+  private:
+    std::vector<Entry> m_entries;
+
+    // Index of the first entry on each line, relative to m_first_line, plus
+    // a final element holding the number of entries
+    std::vector<std::size_t> m_line_starts;
+    int m_first_line{1};
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_TOKEN_TABLE_H
@@ -0,0 +1,306 @@
+#include "transport.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <format>
+#include <iostream>
+#include <span>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <climits>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define CPP2LS_HAVE_POSIX_IO 1
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+namespace cpp2ls {
+
+  namespace {
+    // Bytes asked for per read; most messages arrive in a single read
+    constexpr std::size_t kReadSize = 64 * 1024;
+
+    constexpr std::string_view kHeaderEnd = "\r\n\r\n";
+    constexpr std::string_view kContentLength = "content-length:";
+
+#ifdef CPP2LS_HAVE_POSIX_IO
+    // Buffers per writev call
+    constexpr std::size_t kMaxIovecs = IOV_MAX;
+#endif
+
+    // Value of the Content-Length header in `headers`, which may hold
+    // others, such as Content-Type
+    auto content_length(std::string_view headers)
+        -> std::optional<std::size_t> {
+      while (!headers.empty()) {
+        auto end = headers.find("\r\n");
+        auto line = headers.substr(0, end);
+        headers.remove_prefix(end == std::string_view::npos ? headers.size()
+                                                            : end + 2);
+
+        // Header names are case-insensitive
+        auto name = line.substr(0, kContentLength.size());
+        if (!std::ranges::equal(name, kContentLength, [](char a, char b) {
+              return std::tolower(static_cast<unsigned char>(a)) == b;
+            })) {
+          continue;
+        }
+        auto value = line.substr(name.size());
+        while (!value.empty() && value.front() == ' ') {
+          value.remove_prefix(1);
+        }
+        std::size_t length = 0;
+        auto [end_of_value, ec] = std::from_chars(
+            value.data(), value.data() + value.size(), length);
+        if (ec != std::errc{}) {
+          return std::nullopt;
+        }
+        return length;
+      }
+      return std::nullopt;
+    }
+  }  // namespace
+
+  MessageReader::MessageReader(int fd) : m_fd{fd} {
+#ifdef CPP2LS_HAVE_POSIX_IO
+    if (::pipe(m_wake_fds) != 0) {
+      m_wake_fds[0] = m_wake_fds[1] = -1;
+    }
+#endif
+    m_thread = std::thread{[this] { run(); }};
+  }
+
+  MessageReader::~MessageReader() { stop(); }
+
+  auto MessageReader::next() -> std::optional<IncomingMessage> {
+    return m_queue.pop();
+  }
+
+  void MessageReader::stop() {
+    if (!m_thread.joinable()) {
+      return;
+    }
+
+    // Without a pipe to interrupt it, the thread only notices at the end of
+    // the stream
+#ifdef CPP2LS_HAVE_POSIX_IO
+    if (m_wake_fds[1] >= 0) {
+      char byte = 0;
+      [[maybe_unused]] auto written = ::write(m_wake_fds[1], &byte, 1);
+    }
+#endif
+    m_queue.close();
+    m_thread.join();
+
+#ifdef CPP2LS_HAVE_POSIX_IO
+    for (auto& fd : m_wake_fds) {
+      if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+      }
+    }
+#endif
+  }
+
+  void MessageReader::run() {
+    while (auto body = read_message()) {
+      IncomingMessage message;
+      message.json = langsvr::json::Builder::Create();
+      auto value = message.json->Parse(*body);
+      if (value == langsvr::Success) {
+        message.value = value.Get();
+      } else {
+        message.error = value.Failure().reason;
+      }
+      if (!m_queue.push(std::move(message))) {
+        return;  // stop()
+      }
+    }
+    m_queue.push(std::nullopt);
+  }
+
+  auto MessageReader::read_message() -> std::optional<std::string> {
+    // Drop consumed input once it is most of the buffer, so moving the rest
+    // to the front costs no more than reading it did
+    if (m_start > 0 && m_start >= m_buffer.size() / 2) {
+      m_buffer.erase(0, m_start);
+      m_start = 0;
+    }
+
+    auto header_end = std::string::npos;
+    while ((header_end = m_buffer.find(kHeaderEnd, m_start))
+           == std::string::npos) {
+      if (!fill()) {
+        return std::nullopt;
+      }
+    }
+
+    // There's no way to find the next message without a length
+    auto length = content_length(
+        std::string_view{m_buffer}.substr(m_start, header_end - m_start));
+    if (!length) {
+      std::cerr << "Message without a valid Content-Length header\n";
+      return std::nullopt;
+    }
+
+    auto body_start = header_end + kHeaderEnd.size();
+    while (m_buffer.size() - body_start < *length) {
+      if (!fill()) {
+        return std::nullopt;
+      }
+    }
+    m_start = body_start + *length;
+    return m_buffer.substr(body_start, *length);
+  }
+
+  bool MessageReader::fill() {
+    std::ptrdiff_t count = 0;
+    auto old_size = m_buffer.size();
+    m_buffer.resize_and_overwrite(
+        old_size + kReadSize, [&](char* data, std::size_t) {
+          auto* out = data + old_size;
+#ifdef CPP2LS_HAVE_POSIX_IO
+          while (true) {
+            pollfd fds[2] = {{m_fd, POLLIN, 0}, {m_wake_fds[0], POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0) {
+              if (errno == EINTR) {
+                continue;
+              }
+              count = -1;
+              break;
+            }
+            if (fds[1].revents & POLLIN) {
+              count = 0;  // stop()
+              break;
+            }
+            count = ::read(m_fd, out, kReadSize);
+            if (count >= 0 || errno != EINTR) {
+              break;
+            }
+          }
+#elif defined(_WIN32)
+          count = ::_read(m_fd, out, static_cast<unsigned>(kReadSize));
+#else
+          count = -1;
+#endif
+          return old_size
+                 + static_cast<std::size_t>(std::max<std::ptrdiff_t>(count, 0));
+        });
+    if (count < 0) {
+      std::cerr << "Failed to read from the client\n";
+    }
+    return count > 0;
+  }
+
+  MessageWriter::MessageWriter(int fd) : m_fd{fd} {
+    m_thread = std::thread{[this] { run(); }};
+  }
+
+  MessageWriter::~MessageWriter() { stop(); }
+
+  void MessageWriter::send(std::string content) {
+    m_queue.push(std::move(content));
+  }
+
+  void MessageWriter::stop() {
+    if (m_thread.joinable()) {
+      m_queue.push(std::nullopt);
+      m_thread.join();
+    }
+  }
+
+  void MessageWriter::run() {
+    while (true) {
+      // Everything queued while the last batch was written goes out at once
+      std::vector<std::string> messages;
+      bool stopping = false;
+      for (auto& item : m_queue.take_all()) {
+        if (!item) {
+          stopping = true;
+          break;
+        }
+        messages.push_back(std::move(*item));
+      }
+
+      if (!m_failed && !messages.empty()) {
+        m_failed = !write_all(messages);
+      }
+      if (stopping) {
+        return;
+      }
+    }
+  }
+
+  bool MessageWriter::write_all(const std::vector<std::string>& messages) {
+    std::vector<std::string> headers;
+    headers.reserve(messages.size());
+    for (const auto& message : messages) {
+      headers.push_back(std::format("Content-Length: {}\r\n\r\n",
+                                    message.size()));
+    }
+
+#ifdef CPP2LS_HAVE_POSIX_IO
+    std::vector<iovec> buffers;
+    buffers.reserve(messages.size() * 2);
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+      buffers.push_back({headers[i].data(), headers[i].size()});
+      buffers.push_back({const_cast<char*>(messages[i].data()),
+                         messages[i].size()});
+    }
+
+    std::span<iovec> pending{buffers};
+    while (!pending.empty()) {
+      auto count = std::min(pending.size(), kMaxIovecs);
+      auto written = ::writev(m_fd, pending.data(), static_cast<int>(count));
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::cerr << "Failed to write to the client\n";
+        return false;
+      }
+
+      // Skip what was written, resuming within a partly written buffer
+      auto remaining = static_cast<std::size_t>(written);
+      while (!pending.empty() && remaining >= pending.front().iov_len) {
+        remaining -= pending.front().iov_len;
+        pending = pending.subspan(1);
+      }
+      if (remaining > 0) {
+        auto& front = pending.front();
+        front.iov_base = static_cast<char*>(front.iov_base) + remaining;
+        front.iov_len -= remaining;
+      }
+    }
+    return true;
+#else
+    auto write = [this](std::string_view data) {
+      while (!data.empty()) {
+#ifdef _WIN32
+        auto written = ::_write(m_fd, data.data(),
+                                static_cast<unsigned>(data.size()));
+#else
+        int written = -1;
+#endif
+        if (written <= 0) {
+          std::cerr << "Failed to write to the client\n";
+          return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(written));
+      }
+      return true;
+    };
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+      if (!write(headers[i]) || !write(messages[i])) {
+        return false;
+      }
+    }
+    return true;
+#endif
+  }
+
+}  // namespace cpp2ls
@@ -0,0 +1,106 @@
+#ifndef CPP2LS_TRANSPORT_H
+#define CPP2LS_TRANSPORT_H
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "concurrent_queue.h"
+#include "langsvr/json/builder.h"
+#include "langsvr/json/value.h"
+
+namespace cpp2ls {
+
+  /// A message read from the client, with its JSON already parsed
+  struct IncomingMessage {
+    std::shared_ptr<langsvr::json::Builder> json;  // Owns `value`
+    const langsvr::json::Value* value{nullptr};    // Null if not valid JSON
+    std::string error;                             // Why `value` is null
+  };
+
+  /// Reads `Content-Length` framed messages from a file descriptor on its
+  /// own thread
+  ///
+  /// The thread reads in large blocks, splits them into messages and parses
+  /// each one's JSON before handing it to the consumer, so the thread that
+  /// dispatches messages does nothing else.
+  class MessageReader {
+  public:
+    /// Start reading `fd`
+    explicit MessageReader(int fd);
+    ~MessageReader();
+
+    MessageReader(const MessageReader&) = delete;
+    MessageReader& operator=(const MessageReader&) = delete;
+
+    /// The next message, waiting for it to arrive; nothing once the stream
+    /// ended or broke
+    /// Called from one thread only
+    auto next() -> std::optional<IncomingMessage>;
+
+    /// Stop the reader thread, dropping unread messages
+    /// Called from the thread calling next()
+    void stop();
+
+  private:
+    void run();
+
+    /// Body of the next message, or nothing at the end of the stream
+    auto read_message() -> std::optional<std::string>;
+
+    /// Read more input into m_buffer; false at the end of the stream
+    bool fill();
+
+    int m_fd;
+    int m_wake_fds[2]{-1, -1};  // Pipe that interrupts a read on stop()
+    std::string m_buffer;       // Input not yet consumed, from m_start
+    std::size_t m_start{0};
+
+    // Holds nothing after the last message
+    SpscQueue<std::optional<IncomingMessage>> m_queue{256};
+    std::thread m_thread;
+  };
+
+  /// Writes `Content-Length` framed messages to a file descriptor on its own
+  /// thread
+  ///
+  /// Senders queue messages without waiting for the client; the thread
+  /// writes everything queued since its last write with one gathering
+  /// write call, headers and bodies alike.
+  class MessageWriter {
+  public:
+    /// Start writing to `fd`
+    explicit MessageWriter(int fd);
+    ~MessageWriter();
+
+    MessageWriter(const MessageWriter&) = delete;
+    MessageWriter& operator=(const MessageWriter&) = delete;
+
+    /// Queue the message `content`; any thread
+    void send(std::string content);
+
+    /// Write the messages queued so far, then stop the writer thread
+    void stop();
+
+  private:
+    void run();
+
+    /// Write `messages` with as few system calls as possible; false once
+    /// the output is broken
+    bool write_all(const std::vector<std::string>& messages);
+
+    int m_fd;
+    bool m_failed{false};  // Writer thread only
+
+    // Holds nothing to stop the thread
+    MpscQueue<std::optional<std::string>> m_queue;
+    std::thread m_thread;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_TRANSPORT_H
@@ -0,0 +1,76 @@
+#include "work_done_progress.h"
+
+#include <algorithm>
+#include <format>
+
+namespace cpp2ls {
+
+  namespace {
+    template <typename T>
+    auto any(T value) -> langsvr::lsp::LSPAny {
+      langsvr::lsp::LSPAny result;
+      result.Set(std::move(value));
+      return result;
+    }
+  }  // namespace
+
+  WorkDoneProgress::WorkDoneProgress(langsvr::lsp::ProgressToken token,
+                                     Sender sender)
+      : m_token{std::move(token)}, m_sender{std::move(sender)} {}
+
+  void WorkDoneProgress::begin(const std::string& title,
+                               const std::string& message) {
+    m_active = true;
+    m_percentage = 0;
+
+    langsvr::lsp::LSPObject value;
+    value["kind"] = any(langsvr::lsp::String{
+        langsvr::lsp::WorkDoneProgressBegin::kKind});
+    value["title"] = any(langsvr::lsp::String{title});
+    value["message"] = any(langsvr::lsp::String{message});
+    value["percentage"] = any(langsvr::lsp::Uinteger{0});
+    value["cancellable"] = any(langsvr::lsp::Boolean{false});
+    send(std::move(value));
+  }
+
+  void WorkDoneProgress::report(std::size_t done, std::size_t total) {
+    if (!m_active || total == 0) {
+      return;
+    }
+
+    auto percentage = static_cast<langsvr::lsp::Uinteger>(
+        std::min(done, total) * 100 / total);
+    if (percentage <= m_percentage) {
+      return;
+    }
+    m_percentage = percentage;
+
+    langsvr::lsp::LSPObject value;
+    value["kind"] = any(langsvr::lsp::String{
+        langsvr::lsp::WorkDoneProgressReport::kKind});
+    value["message"] = any(std::format("{}/{} files", done, total));
+    value["percentage"] = any(percentage);
+    send(std::move(value));
+  }
+
+  void WorkDoneProgress::end(const std::string& message) {
+    if (!m_active) {
+      return;
+    }
+    m_active = false;
+
+    langsvr::lsp::LSPObject value;
+    value["kind"] = any(
+        langsvr::lsp::String{langsvr::lsp::WorkDoneProgressEnd::kKind});
+    value["message"] = any(langsvr::lsp::String{message});
+    send(std::move(value));
+  }
+
+  void WorkDoneProgress::send(langsvr::lsp::LSPObject value) {
+    langsvr::lsp::ProgressNotification notification;
+    notification.token = m_token;
+    notification.value.Set(std::move(value));
+    m_sender(notification);
+  }
+
+}  // namespace cpp2ls
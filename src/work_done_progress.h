@@ -0,0 +1,45 @@
+#ifndef CPP2LS_WORK_DONE_PROGRESS_H
+#define CPP2LS_WORK_DONE_PROGRESS_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "langsvr/lsp/lsp.h"
+
+namespace cpp2ls {
+
+  /// Reports a long-running operation through `$/progress` notifications
+  ///
+  /// The token must have been created by the client (or handed to us in a
+  /// request) before begin() is called. Reports are only sent when the
+  /// percentage changes, so calling report() for every unit of work is cheap.
+  class WorkDoneProgress {
+  public:
+    /// Sends one notification; called on the thread calling the methods below
+    using Sender
+        = std::function<void(const langsvr::lsp::ProgressNotification&)>;
+
+    WorkDoneProgress(langsvr::lsp::ProgressToken token, Sender sender);
+
+    /// Start the operation
+    void begin(const std::string& title, const std::string& message);
+
+    /// Report that `done` of `total` units have finished
+    void report(std::size_t done, std::size_t total);
+
+    /// Finish the operation; later calls are ignored
+    void end(const std::string& message);
+
+  private:
+    void send(langsvr::lsp::LSPObject value);
+
+    langsvr::lsp::ProgressToken m_token;
+    Sender m_sender;
+    langsvr::lsp::Uinteger m_percentage{0};
+    bool m_active{false};
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_WORK_DONE_PROGRESS_H
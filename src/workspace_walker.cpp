@@ -0,0 +1,578 @@
+#include "workspace_walker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+
+#include "thread_pool.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cpp2ls {
+
+  namespace {
+    enum class EntryType { File, Directory, Symlink, Other, Unknown };
+
+    struct DirectoryEntry {
+      std::string name;
+      EntryType type{EntryType::Unknown};
+    };
+
+#ifdef __linux__
+    // Layout of a linux_dirent64 record: d_ino (8), d_off (8),
+    // d_reclen (2), d_type (1), then the NUL-terminated name
+    constexpr std::size_t kDirentReclen = 16;
+    constexpr std::size_t kDirentType = 18;
+    constexpr std::size_t kDirentName = 19;
+
+    auto entry_type(unsigned char d_type) -> EntryType {
+      switch (d_type) {
+        case DT_REG:
+          return EntryType::File;
+        case DT_DIR:
+          return EntryType::Directory;
+        case DT_LNK:
+          return EntryType::Symlink;
+        case DT_UNKNOWN:
+          return EntryType::Unknown;
+        default:
+          return EntryType::Other;
+      }
+    }
+
+    /// Read a directory with getdents64, a buffer full of entries at a time
+    auto list_directory(const std::filesystem::path& dir)
+        -> std::vector<DirectoryEntry> {
+      std::vector<DirectoryEntry> entries;
+      int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (fd < 0) {
+        return entries;
+      }
+
+      alignas(8) char buffer[32 * 1024];
+      long length;
+      while ((length = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer)))
+             > 0) {
+        for (long offset = 0; offset < length;) {
+          const char* record = buffer + offset;
+          std::uint16_t reclen;
+          std::memcpy(&reclen, record + kDirentReclen, sizeof(reclen));
+          offset += reclen;
+
+          std::string_view name{record + kDirentName};
+          if (name == "." || name == "..") {
+            continue;
+          }
+          entries.push_back(
+              {std::string(name),
+               entry_type(static_cast<unsigned char>(record[kDirentType]))});
+        }
+      }
+
+      ::close(fd);
+      return entries;
+    }
+#else
+    auto list_directory(const std::filesystem::path& dir)
+        -> std::vector<DirectoryEntry> {
+      std::vector<DirectoryEntry> entries;
+      std::error_code ec;
+      for (std::filesystem::directory_iterator it(dir, ec), end;
+           !ec && it != end; it.increment(ec)) {
+        auto status = it->symlink_status(ec);
+        auto type = EntryType::Other;
+        if (std::filesystem::is_regular_file(status)) {
+          type = EntryType::File;
+        } else if (std::filesystem::is_directory(status)) {
+          type = EntryType::Directory;
+        } else if (std::filesystem::is_symlink(status)) {
+          type = EntryType::Symlink;
+        }
+        entries.push_back({it->path().filename().string(), type});
+      }
+      return entries;
+    }
+#endif
+
+    /// Settle entries whose type the directory didn't report; symlinks
+    /// count as the file they point to, symlinked directories are skipped
+    auto resolve_type(const std::filesystem::path& path, EntryType type)
+        -> EntryType {
+      std::error_code ec;
+      if (type == EntryType::Unknown) {
+        auto status = std::filesystem::symlink_status(path, ec);
+        if (std::filesystem::is_regular_file(status)) {
+          return EntryType::File;
+        }
+        if (std::filesystem::is_directory(status)) {
+          return EntryType::Directory;
+        }
+        type = std::filesystem::is_symlink(status) ? EntryType::Symlink
+                                                   : EntryType::Other;
+      }
+      if (type == EntryType::Symlink) {
+        return std::filesystem::is_regular_file(path, ec) ? EntryType::File
+                                                          : EntryType::Other;
+      }
+      return type;
+    }
+
+    auto is_cpp2_file(std::string_view name) -> bool {
+      return name.ends_with(".cpp2") || name.ends_with(".h2");
+    }
+
+    auto basename(std::string_view path) -> std::string_view {
+      auto slash = path.rfind('/');
+      return slash == std::string_view::npos ? path : path.substr(slash + 1);
+    }
+
+    /// Match one `[...]` class at the start of `pattern` against `c`
+    /// Returns the class length, or 0 if `c` doesn't match
+    auto match_class(std::string_view pattern, char c) -> std::size_t {
+      std::size_t i = 1;
+      bool negate = i < pattern.size()
+                    && (pattern[i] == '!' || pattern[i] == '^');
+      if (negate) {
+        ++i;
+      }
+      bool matched = false;
+      bool first = true;
+      for (; i < pattern.size() && (first || pattern[i] != ']'); ++i) {
+        first = false;
+        if (i + 2 < pattern.size() && pattern[i + 1] == '-'
+            && pattern[i + 2] != ']') {
+          matched |= pattern[i] <= c && c <= pattern[i + 2];
+          i += 2;
+        } else {
+          matched |= pattern[i] == c;
+        }
+      }
+      if (i >= pattern.size()) {
+        // Unterminated: a literal '['
+        return c == '[' ? 1 : 0;
+      }
+      return matched != negate && c != '/' ? i + 1 : 0;
+    }
+  }  // namespace
+
+  auto glob_match(std::string_view pattern, std::string_view path) -> bool {
+    while (!pattern.empty()) {
+      if (pattern.starts_with("**")) {
+        auto rest = pattern.substr(2);
+        if (rest.starts_with('/')) {
+          // "**/" matches zero or more whole directories
+          rest.remove_prefix(1);
+          for (std::size_t i = 0; i <= path.size(); ++i) {
+            if ((i == 0 || path[i - 1] == '/')
+                && glob_match(rest, path.substr(i))) {
+              return true;
+            }
+          }
+          return false;
+        }
+        for (std::size_t i = 0; i <= path.size(); ++i) {
+          if (glob_match(rest, path.substr(i))) {
+            return true;
+          }
+        }
+        return false;
+      }
+
+      if (pattern[0] == '*') {
+        auto rest = pattern.substr(1);
+        for (std::size_t i = 0; i <= path.size(); ++i) {
+          if (glob_match(rest, path.substr(i))) {
+            return true;
+          }
+          if (i < path.size() && path[i] == '/') {
+            break;
+          }
+        }
+        return false;
+      }
+
+      if (path.empty()) {
+        return false;
+      }
+
+      if (pattern[0] == '?') {
+        if (path[0] == '/') {
+          return false;
+        }
+        pattern.remove_prefix(1);
+      } else if (pattern[0] == '[') {
+        auto length = match_class(pattern, path[0]);
+        if (length == 0) {
+          return false;
+        }
+        pattern.remove_prefix(length);
+      } else {
+        if (pattern[0] == '\\' && pattern.size() > 1) {
+          pattern.remove_prefix(1);
+        }
+        if (pattern[0] != path[0]) {
+          return false;
+        }
+        pattern.remove_prefix(1);
+      }
+      path.remove_prefix(1);
+    }
+    return path.empty();
+  }
+
+  /// One gitignore-style pattern
+  struct WorkspaceWalker::Rule {
+    std::string pattern;
+    bool negate{false};    // "!pattern" re-includes
+    bool dir_only{false};  // "pattern/" matches only directories
+    bool anchored{false};  // Contains a '/': matched against the whole path
+
+    /// Parse a line; returns nothing for blank lines and comments
+    static auto parse(std::string_view line) -> std::optional<Rule> {
+      while (!line.empty()
+             && (line.back() == '\r' || line.back() == ' '
+                 || line.back() == '\t')) {
+        line.remove_suffix(1);
+      }
+      if (line.empty() || line[0] == '#') {
+        return std::nullopt;
+      }
+
+      Rule rule;
+      if (line[0] == '!') {
+        rule.negate = true;
+        line.remove_prefix(1);
+      } else if (line.starts_with("\\!") || line.starts_with("\\#")) {
+        line.remove_prefix(1);
+      }
+      if (line.ends_with('/')) {
+        rule.dir_only = true;
+        line.remove_suffix(1);
+      }
+      rule.anchored = line.find('/') != std::string_view::npos;
+      if (line.starts_with('/')) {
+        line.remove_prefix(1);
+      }
+      if (line.empty()) {
+        return std::nullopt;
+      }
+      rule.pattern = line;
+      return rule;
+    }
+
+    /// Match a path relative to the directory the rule applies in
+    auto matches(std::string_view rel, bool is_dir) const -> bool {
+      if (dir_only && !is_dir) {
+        return false;
+      }
+      return glob_match(pattern, anchored ? rel : basename(rel));
+    }
+  };
+
+  /// The rules of one .gitignore, chained to those of its parent directories
+  struct WorkspaceWalker::RuleSet {
+    std::string base;  // Workspace-relative directory, "" for the root
+    std::vector<Rule> rules;
+    std::shared_ptr<const RuleSet> parent;
+  };
+
+  /// State shared by the directory tasks of one walk
+  struct WorkspaceWalker::Walk {
+    /// A directory still to list
+    struct Pending {
+      std::string rel;
+      bool ignored{false};
+      std::shared_ptr<const RuleSet> gitignore;
+    };
+
+    std::mutex mutex;
+    Result result;
+    TaskGroup* tasks{nullptr};     // Lists subdirectories, if set
+    std::vector<Pending> pending;  // Otherwise they wait here
+  };
+
+  WorkspaceWalker::WorkspaceWalker(std::filesystem::path root,
+                                   WalkOptions options)
+      : m_root{std::move(root)}, m_options{std::move(options)} {
+    for (const auto& glob : m_options.exclude) {
+      if (auto rule = Rule::parse(glob)) {
+        m_exclude.push_back(std::move(*rule));
+      }
+    }
+    for (const auto& glob : m_options.include) {
+      if (auto rule = Rule::parse(glob)) {
+        m_include.push_back(std::move(*rule));
+      }
+    }
+  }
+
+  WorkspaceWalker::~WorkspaceWalker() = default;
+
+  auto WorkspaceWalker::root() const -> const std::filesystem::path& {
+    return m_root;
+  }
+
+  auto WorkspaceWalker::walk(const std::filesystem::path& dir,
+                             WorkStealingPool* pool) const -> Result {
+    auto rel = relative(dir);
+    if (!rel) {
+      return {};
+    }
+    auto context = enter(*rel);
+    if (!context) {
+      return {};
+    }
+
+    Walk walk;
+    if (pool) {
+      TaskGroup tasks{*pool, TaskPriority::Background};
+      walk.tasks = &tasks;
+      tasks.submit([this, &walk, rel = std::move(*rel), context] {
+        visit(walk, rel, context->ignored, context->gitignore);
+      });
+      tasks.wait();
+    } else {
+      walk.pending.push_back(
+          {std::move(*rel), context->ignored, context->gitignore});
+      while (!walk.pending.empty()) {
+        auto next = std::move(walk.pending.back());
+        walk.pending.pop_back();
+        visit(walk, std::move(next.rel), next.ignored,
+              std::move(next.gitignore));
+      }
+    }
+
+    std::ranges::sort(walk.result.files);
+    std::ranges::sort(walk.result.directories);
+    return std::move(walk.result);
+  }
+
+  auto WorkspaceWalker::accepts(const std::filesystem::path& file) const
+      -> bool {
+    auto name = file.filename().string();
+    if (name.starts_with('.') || !is_cpp2_file(name)) {
+      return false;
+    }
+    auto rel = relative(file);
+    if (!rel) {
+      return false;
+    }
+    auto dir_rel = rel->substr(0, rel->size() - std::min(rel->size(),
+                                                          name.size() + 1));
+    auto context = enter(dir_rel);
+    if (!context) {
+      return false;
+    }
+
+    // What visit() would find in the file's directory
+    auto dir = file.parent_path();
+    std::error_code ec;
+    if (!dir_rel.empty() && std::filesystem::exists(dir / "CMakeCache.txt", ec)
+        && !is_included(dir_rel)) {
+      context->ignored = true;
+    }
+    if (m_options.use_gitignore) {
+      context->gitignore
+          = load_gitignore(dir, dir_rel, std::move(context->gitignore));
+    }
+    return is_included(*rel)
+           || (!context->ignored
+               && !is_ignored(*rel, false, context->gitignore.get()));
+  }
+
+  auto WorkspaceWalker::relative(const std::filesystem::path& path) const
+      -> std::optional<std::string> {
+    auto rel_path = path.lexically_relative(m_root);
+    if (rel_path.empty() || *rel_path.begin() == "..") {
+      return std::nullopt;  // Outside the workspace
+    }
+    auto rel = rel_path.generic_string();
+    if (rel == ".") {
+      rel.clear();
+    }
+    return rel;
+  }
+
+  auto WorkspaceWalker::enter(std::string_view rel) const
+      -> std::optional<Context> {
+    Context context;
+    std::string prefix;
+    for (const auto& part : std::filesystem::path(rel)) {
+      auto parent = prefix.empty() ? m_root : m_root / prefix;
+      if (m_options.use_gitignore) {
+        context.gitignore
+            = load_gitignore(parent, prefix, std::move(context.gitignore));
+      }
+      std::error_code ec;
+      if (!prefix.empty()
+          && std::filesystem::exists(parent / "CMakeCache.txt", ec)
+          && !is_included(prefix)) {
+        context.ignored = true;
+      }
+
+      auto name = part.string();
+      prefix = prefix.empty() ? name : prefix + '/' + name;
+      if (name.starts_with('.')) {
+        return std::nullopt;
+      }
+      context.ignored = (context.ignored
+                         || is_ignored(prefix, true, context.gitignore.get()))
+                        && !is_included(prefix);
+      if (context.ignored && !may_include_below(prefix)) {
+        return std::nullopt;
+      }
+    }
+    return context;
+  }
+
+  void WorkspaceWalker::visit(Walk& walk, std::string rel, bool ignored,
+                              std::shared_ptr<const RuleSet> gitignore) const {
+    auto dir = rel.empty() ? m_root : m_root / rel;
+    auto entries = list_directory(dir);
+
+    bool has_gitignore = false;
+    bool build_tree = false;
+    for (const auto& entry : entries) {
+      has_gitignore |= entry.name == ".gitignore";
+      build_tree |= entry.name == "CMakeCache.txt";
+    }
+    // The root may be an in-source build; only nested build trees are pruned
+    if (build_tree && !rel.empty() && !is_included(rel)) {
+      ignored = true;
+      if (!may_include_below(rel)) {
+        return;
+      }
+    }
+    if (has_gitignore && m_options.use_gitignore) {
+      gitignore = load_gitignore(dir, rel, std::move(gitignore));
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : entries) {
+      if (entry.name.starts_with('.')) {
+        continue;
+      }
+
+      auto child = rel.empty() ? entry.name : rel + '/' + entry.name;
+      auto type = entry.type;
+      if (type == EntryType::Unknown || type == EntryType::Symlink) {
+        type = resolve_type(dir / entry.name, type);
+      }
+
+      if (type == EntryType::Directory) {
+        bool child_ignored
+            = (ignored || is_ignored(child, true, gitignore.get()))
+              && !is_included(child);
+        if (child_ignored && !may_include_below(child)) {
+          continue;
+        }
+        if (walk.tasks) {
+          walk.tasks->submit([this, &walk, child = std::move(child),
+                              child_ignored, gitignore] {
+            visit(walk, child, child_ignored, gitignore);
+          });
+        } else {
+          walk.pending.push_back({std::move(child), child_ignored, gitignore});
+        }
+      } else if (type == EntryType::File && is_cpp2_file(entry.name)) {
+        if (is_included(child)
+            || (!ignored && !is_ignored(child, false, gitignore.get()))) {
+          files.push_back(dir / entry.name);
+        }
+      }
+    }
+
+    std::lock_guard lock{walk.mutex};
+    std::ranges::move(files, std::back_inserter(walk.result.files));
+    walk.result.directories.push_back(std::move(dir));
+  }
+
+  auto WorkspaceWalker::load_gitignore(const std::filesystem::path& dir,
+                                       std::string rel,
+                                       std::shared_ptr<const RuleSet> parent)
+      const -> std::shared_ptr<const RuleSet> {
+    std::ifstream file(dir / ".gitignore");
+    if (!file) {
+      return parent;
+    }
+
+    auto rules = std::make_shared<RuleSet>();
+    std::string line;
+    while (std::getline(file, line)) {
+      if (auto rule = Rule::parse(line)) {
+        rules->rules.push_back(std::move(*rule));
+      }
+    }
+    if (rules->rules.empty()) {
+      return parent;
+    }
+    rules->base = std::move(rel);
+    rules->parent = std::move(parent);
+    return rules;
+  }
+
+  auto WorkspaceWalker::is_ignored(std::string_view rel, bool is_dir,
+                                   const RuleSet* gitignore) const -> bool {
+    for (const auto& rule : m_exclude) {
+      if (rule.matches(rel, is_dir)) {
+        return true;
+      }
+    }
+
+    // Rules of deeper .gitignore files come later; the last match wins
+    std::vector<const RuleSet*> chain;
+    for (auto* set = gitignore; set; set = set->parent.get()) {
+      chain.push_back(set);
+    }
+    bool ignored = false;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      auto sub = rel;
+      if (!(*it)->base.empty()) {
+        sub.remove_prefix(std::min((*it)->base.size() + 1, sub.size()));
+      }
+      for (const auto& rule : (*it)->rules) {
+        if (rule.matches(sub, is_dir)) {
+          ignored = !rule.negate;
+        }
+      }
+    }
+    return ignored;
+  }
+
+  auto WorkspaceWalker::is_included(std::string_view rel) const -> bool {
+    return std::ranges::any_of(m_include, [rel](const Rule& rule) {
+      return rule.matches(rel, true);
+    });
+  }
+
+  auto WorkspaceWalker::may_include_below(std::string_view rel) const -> bool {
+    for (const auto& rule : m_include) {
+      if (!rule.anchored) {
+        return true;  // Matches names at any depth
+      }
+
+      // The directories before the first wildcard are fixed
+      auto wildcard = rule.pattern.find_first_of("*?[");
+      auto fixed = std::string_view(rule.pattern).substr(0, wildcard);
+      if (wildcard != std::string::npos) {
+        auto slash = fixed.rfind('/');
+        fixed = slash == std::string_view::npos ? std::string_view{}
+                                                : fixed.substr(0, slash);
+      }
+      if (fixed.empty() || fixed == rel
+          || (fixed.starts_with(rel) && fixed[rel.size()] == '/')
+          || (rel.starts_with(fixed) && rel[fixed.size()] == '/')) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+}  // namespace cpp2ls
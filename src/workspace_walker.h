@@ -0,0 +1,113 @@
+#ifndef CPP2LS_WORKSPACE_WALKER_H
+#define CPP2LS_WORKSPACE_WALKER_H
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpp2ls {
+
+  class WorkStealingPool;
+
+  /// Match `path` against a glob
+  /// `*` and `?` stay within one path component, `**` spans components
+  /// (`**/` also matches none) and `[...]` is a character class.
+  auto glob_match(std::string_view pattern, std::string_view path) -> bool;
+
+  /// Which parts of the workspace to search for cpp2 files
+  struct WalkOptions {
+    /// Paths to skip, as globs against the workspace-relative path; globs
+    /// without a `/` match the name of a file or directory at any depth
+    std::vector<std::string> exclude{"node_modules"};
+
+    /// Paths to index even where .gitignore or `exclude` would skip them,
+    /// such as generated sources in a build directory
+    std::vector<std::string> include;
+
+    /// Skip what the workspace's .gitignore files ignore
+    bool use_gitignore{true};
+  };
+
+  /// Finds the cpp2 files of a workspace
+  ///
+  /// Hidden directories, excluded and git-ignored directories, and build
+  /// trees (subdirectories holding a CMakeCache.txt) are pruned before they are
+  /// listed. Directories are read in large batches (getdents64 on Linux)
+  /// using the entry types the directory reports, so files are never
+  /// stat'ed, and subtrees are listed in parallel on the caller's pool.
+  /// Immutable, so one walker can serve several threads.
+  class WorkspaceWalker {
+  public:
+    /// What a walk found
+    struct Result {
+      std::vector<std::filesystem::path> files;        // Sorted
+      std::vector<std::filesystem::path> directories;  // Sorted, not pruned
+    };
+
+    WorkspaceWalker(std::filesystem::path root, WalkOptions options);
+    ~WorkspaceWalker();
+
+    /// Walk `dir`, which is the root or lies below it
+    /// Subdirectories are listed as Background tasks on `pool`, or one after
+    /// another on the calling thread without one; don't pass the pool of
+    /// the calling worker. A directory that is itself pruned yields an
+    /// empty result.
+    auto walk(const std::filesystem::path& dir,
+              WorkStealingPool* pool = nullptr) const -> Result;
+
+    /// Whether a walk would report `file`, a path below the root
+    auto accepts(const std::filesystem::path& file) const -> bool;
+
+    /// The workspace root
+    auto root() const -> const std::filesystem::path&;
+
+  private:
+    struct Rule;
+    struct RuleSet;
+    struct Walk;
+
+    /// Where a walk into a directory starts from
+    struct Context {
+      bool ignored{false};  // Only included paths below count
+      std::shared_ptr<const RuleSet> gitignore;
+    };
+
+    /// `path` relative to the root with '/' separators, if it is below it
+    auto relative(const std::filesystem::path& path) const
+        -> std::optional<std::string>;
+
+    /// Check the directories on the way to `rel` and collect their
+    /// .gitignore files; returns nothing if one of them prunes it
+    auto enter(std::string_view rel) const -> std::optional<Context>;
+
+    /// Load the .gitignore of the directory at `rel` on top of `parent`
+    auto load_gitignore(const std::filesystem::path& dir, std::string rel,
+                        std::shared_ptr<const RuleSet> parent) const
+        -> std::shared_ptr<const RuleSet>;
+
+    /// Whether excludes or the .gitignore files skip `rel`
+    auto is_ignored(std::string_view rel, bool is_dir,
+                    const RuleSet* gitignore) const -> bool;
+
+    /// Whether `rel` matches an include glob
+    auto is_included(std::string_view rel) const -> bool;
+
+    /// Whether an include glob may match something below directory `rel`
+    auto may_include_below(std::string_view rel) const -> bool;
+
+    /// List one directory and queue its subdirectories on `walk`
+    void visit(Walk& walk, std::string rel, bool ignored,
+               std::shared_ptr<const RuleSet> gitignore) const;
+
+    std::filesystem::path m_root;
+    WalkOptions m_options;
+    std::vector<Rule> m_exclude;
+    std::vector<Rule> m_include;
+  };
+
+}  // namespace cpp2ls
+
+#endif  // !CPP2LS_WORKSPACE_WALKER_H
@@ -42,6 +42,7 @@
 #ifndef CPP2_COMMON_H
 #define CPP2_COMMON_H
 
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <chrono>
@@ -1042,6 +1043,46 @@ struct error_entry
 };
 
 
+//-----------------------------------------------------------------------
+//
+//  cancellation: lets a host abandon a lex/parse/sema run part way
+//
+//  A host that runs the pipeline on a thread may point that thread's
+//  cancel_flag at an atomic flag it can set from another thread. The
+//  lexer, parser and sema call cancellation_point() once per line,
+//  statement, declaration, visited token and checked symbol; every
+//  cancellation_interval calls it checks the flag and throws
+//  parse_cancelled once it is set.
+//  The partial results of a cancelled run must be discarded.
+//
+//  parse_cancelled doesn't derive from std::exception, so handlers for
+//  cppfront's own errors let it through.
+//
+//-----------------------------------------------------------------------
+//
+struct parse_cancelled { };
+
+inline thread_local std::atomic<bool> const* cancel_flag = nullptr;
+
+constexpr auto cancellation_interval = 256;
+
+inline auto cancellation_point()
+    -> void
+{
+    static thread_local auto countdown = cancellation_interval;
+    if (
+        cancel_flag
+        && --countdown <= 0
+        )
+    {
+        countdown = cancellation_interval;
+        if (cancel_flag->load(std::memory_order_relaxed)) {
+            throw parse_cancelled{};
+        }
+    }
+}
+
+
 //-----------------------------------------------------------------------
 //
 //  stable_vector: a simple segmented vector with limited interface
@@ -892,7 +892,107 @@ public:
             if( !fss.is_open()) { return false; }
         }
         std::istream& in = is_stdin ? std::cin : fss;
-    
+
+        return load_lines(
+            [&] { return static_cast<bool>(in.getline(&buf[0], max_line_len)); },
+            [&] {
+                //  Because I encountered very long lines in real-world code during testing
+                //
+                if (in.gcount() >= max_line_len-1)
+                {
+                    errors.emplace_back(
+                        source_position(lineno_t(std::ssize(lines)), 0),
+                        std::string("source line too long - length must be less than ")
+                            + std::to_string(max_line_len)
+                    );
+                    return false;
+                }
+
+                //  This shouldn't be possible, so check it anyway
+                //
+                if (!in.eof())
+                {
+                    errors.emplace_back(
+                        source_position(lineno_t(std::ssize(lines)), 0),
+                        std::string("unexpected error reading source lines - did not reach EOF"),
+                        false,
+                        true    // a noisy fallback error
+                    );
+                    return false;
+                }
+
+                return true;
+            }
+        );
+    }
+
+
+    //-----------------------------------------------------------------------
+    //  load_from_memory: Read a line-by-line view of an in-memory buffer,
+    //                    such as an editor's unsaved document text, with the
+    //                    same line splitting as 'load' but no file round-trip
+    //
+    //  text                    the source text to be loaded
+    //
+    auto load_from_memory(
+        std::string_view    text
+    )
+        -> bool
+    {
+        auto pos      = std::string_view::size_type{0};
+        auto too_long = false;
+
+        return load_lines(
+            [&] {
+                if (pos >= text.size()) {
+                    return false;
+                }
+                auto end = text.find('\n', pos);
+                if (end == text.npos) {
+                    end = text.size();
+                }
+                auto len = end - pos;
+                if (len >= max_line_len-1) {
+                    too_long = true;
+                    return false;
+                }
+                text.copy(&buf[0], len, pos);
+                buf[len] = '\0';
+                pos = end + 1;
+                return true;
+            },
+            [&] {
+                if (too_long)
+                {
+                    errors.emplace_back(
+                        source_position(lineno_t(std::ssize(lines)), 0),
+                        std::string("source line too long - length must be less than ")
+                            + std::to_string(max_line_len)
+                    );
+                    return false;
+                }
+                return true;
+            }
+        );
+    }
+
+
+private:
+    //-----------------------------------------------------------------------
+    //  load_lines: Categorize lines as they are produced by 'next_line'
+    //
+    //  next_line               reads the next line into 'buf', returns false
+    //                          when there are no more lines
+    //  reached_end             called once 'next_line' returns false, reports
+    //                          any read error and returns false if one occurred
+    //
+    template <typename NextLine, typename ReachedEnd>
+    auto load_lines(
+        NextLine&&          next_line,
+        ReachedEnd&&        reached_end
+    )
+        -> bool
+    {
         auto in_comment            = false;
         auto in_string_literal     = false;
         auto in_raw_string_literal = false;
@@ -919,7 +1019,7 @@ public:
             }
         };
 
-        while (in.getline(&buf[0], max_line_len)) {
+        while (next_line()) {
 
             //  Handle preprocessor source separately, they're outside the language
             //
@@ -933,7 +1033,7 @@ public:
                 add_preprocessor_line();
                 while (
                     pre.has_continuation
-                    && in.getline(&buf[0], max_line_len)
+                    && next_line()
                     )
                 {
                     add_preprocessor_line();
@@ -979,7 +1079,7 @@ public:
                             unchecked_narrow<lineno_t>(std::ssize(lines)-1),
                             errors
                         )
-                        && in.getline(&buf[0], max_line_len)
+                        && next_line()
                         )
                     {
                         lines.push_back({ &buf[0], source_line::category::cpp2 });
@@ -1021,28 +1121,7 @@ public:
             }
         }
 
-        //  Because I encountered very long lines in real-world code during testing
-        //
-        if (in.gcount() >= max_line_len-1)
-        {
-            errors.emplace_back(
-                source_position(lineno_t(std::ssize(lines)), 0),
-                std::string("source line too long - length must be less than ")
-                    + std::to_string(max_line_len)
-            );
-            return false;
-        }
-
-        //  This shouldn't be possible, so check it anyway
-        //
-        if (!in.eof())
-        {
-            errors.emplace_back(
-                source_position(lineno_t(std::ssize(lines)), 0),
-                std::string("unexpected error reading source lines - did not reach EOF"),
-                false,
-                true    // a noisy fallback error
-            );
+        if (!reached_end()) {
             return false;
         }
 
@@ -1052,6 +1131,9 @@ public:
     }
 
 
+public:
+
+
     //-----------------------------------------------------------------------
     //  get_lines: Access the source lines
     //
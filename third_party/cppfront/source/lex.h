@@ -344,11 +344,11 @@ auto labelized_position(token const* t)
     struct label {
         std::string text;
         label() {
-            static auto ordinal = 0;                                        // TODO: static
+            static thread_local auto ordinal = 0;                           // TODO: static
             text = std::to_string(++ordinal);
         }
     };
-    static auto labels = std::unordered_map<token const*, label const>{};   // TODO: static
+    static thread_local auto labels = std::unordered_map<token const*, label const>{};   // TODO: static
 
     assert (t);
     return labels[t].text;
@@ -609,11 +609,15 @@ auto expand_raw_string_literal(
 //  A stable place to store additional text for source tokens that are merged
 //  into a whitespace-containing token (to merge the Cpp1 multi-token keywords)
 //  -- this isn't about tokens generated later, that's tokens::generated_tokens
-static auto generated_text  = stable_vector<std::string>{};                // TODO: static
-static auto generated_lines = stable_vector<std::vector<source_line>>{};   // TODO: static
+//
+//  These and the other lexer/parser globals are per thread, so independent
+//  lex/parse/sema runs can proceed on different threads; a run's tokens may
+//  point into this storage until take_generated_storage() moves it out
+static thread_local auto generated_text  = stable_vector<std::string>{};                // TODO: static
+static thread_local auto generated_lines = stable_vector<std::vector<source_line>>{};   // TODO: static
 
 
-static auto multiline_raw_strings = stable_vector<multiline_raw_string>{}; // TODO: static
+static thread_local auto multiline_raw_strings = stable_vector<multiline_raw_string>{}; // TODO: static
 
 auto lex_line(
     std::string&               mutable_line,
@@ -2000,6 +2004,7 @@ public:
                 ++line, ++lineno
                 )
             {
+                cancellation_point();
                 lex_line(
                     line->text, lineno,
                     in_comment, current_comment, current_comment_start,
@@ -2122,7 +2127,32 @@ public:
 
 };
 
-static auto generated_lexers = stable_vector<tokens>{};    // TODO: static
+static thread_local auto generated_lexers = stable_vector<tokens>{};    // TODO: static
+
+
+//  Everything generated on one thread by a lex/parse/sema run, taken off the
+//  thread so the run's tokens can outlive it. Moving a stable_vector keeps
+//  its elements in place, so pointers into them stay valid
+struct generated_storage
+{
+    stable_vector<std::string>              text;
+    stable_vector<std::vector<source_line>> lines;
+    stable_vector<multiline_raw_string>     raw_strings;
+    stable_vector<tokens>                   lexers;
+};
+
+//  Move out what this thread generated since the last call, leaving its
+//  storage empty for the next run
+inline auto take_generated_storage()
+    -> generated_storage
+{
+    return {
+        std::exchange(generated_text,        {}),
+        std::exchange(generated_lines,       {}),
+        std::exchange(multiline_raw_strings, {}),
+        std::exchange(generated_lexers,      {})
+    };
+}
 
 }
 
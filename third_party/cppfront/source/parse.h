@@ -18,7 +18,7 @@
 
 namespace cpp2 {
 
-auto violates_lifetime_safety = false;
+thread_local auto violates_lifetime_safety = false;
 
 //-----------------------------------------------------------------------
 //  Operator categorization
@@ -556,7 +556,7 @@ struct expression_statement_node;
 
 struct expression_node
 {
-    static inline std::vector<expression_node*> current_expressions = {};   // TODO: static ?
+    static inline thread_local std::vector<expression_node*> current_expressions = {};   // TODO: static ?
 
     std::unique_ptr<assignment_expression_node> expr;
     int num_subexpressions = 0;
@@ -843,7 +843,7 @@ auto primary_expression_node::get_literal() const
 
 struct expression_statement_node
 {
-    static inline std::vector<expression_statement_node*> current_expression_statements = {};   // TODO: static ?
+    static inline thread_local std::vector<expression_statement_node*> current_expression_statements = {};   // TODO: static ?
 
     std::unique_ptr<expression_node> expr;
     bool has_semicolon = false;
@@ -5012,7 +5012,7 @@ auto primary_expression_node::to_string() const
 //-----------------------------------------------------------------------
 //  pre: Get an indentation prefix
 //
-inline static int         indent_spaces  = 2;
+inline static thread_local int indent_spaces = 2;
 inline static std::string indent_str     = std::string( 1024, ' ' );    // "1K should be enough for everyone"
 
 auto pre(int indent)
@@ -5742,7 +5742,7 @@ auto pretty_print_visualize(
         && !n.is_parameter()
         )
     {
-        static declaration_node const* last_parent_type = {};
+        static thread_local declaration_node const* last_parent_type = {};
         if (n.parent_is_type()) {
             if (last_parent_type != n.get_parent()) {
                 last_parent_type = n.get_parent();
@@ -8151,6 +8151,8 @@ private:
     )
         -> std::unique_ptr<statement_node>
     {
+        cancellation_point();
+
         if (!done() && curr().type() == lexeme::Semicolon) {
             error("empty statement is not allowed - remove extra semicolon");
             return {};
@@ -9715,6 +9717,7 @@ private:
         -> std::unique_ptr<declaration_node>
     {
         if (done()) { return {}; }
+        cancellation_point();
 
         //  Remember current position, because we need to look ahead
         auto start_pos = pos;
@@ -299,7 +299,7 @@ struct symbol {
 //  of the form "x = expr;" for an uninitialized local variable x,
 //  which we will rewrite to construct the local variable.
 //
-std::vector<token const*> definite_initializations;
+thread_local std::vector<token const*> definite_initializations;
 
 auto is_definite_initialization(token const* t)
     -> bool
@@ -335,7 +335,7 @@ struct last_use {
 
     bool operator==(last_use const& that) { return t == that.t; }
 };
-std::vector<last_use> definite_last_uses;
+thread_local std::vector<last_use> definite_last_uses;
 
 auto is_definite_last_use(token const* t)
     -> last_use const*
@@ -724,6 +724,8 @@ public:
         //
         for (auto sympos = unchecked_narrow<int>(std::ssize(symbols) - 1); sympos >= 0; --sympos)
         {
+            cancellation_point();
+
             //  If this is an uninitialized local variable,
             //  ensure it is definitely initialized and tag those initializations
             //
@@ -2496,6 +2498,8 @@ public:
 
     auto start(token const& t, int) -> void
     {
+        cancellation_point();
+
         //  By giving tokens an order during sema
         //  generated code can be equally checked
         t.set_global_token_order( global_token_counter );
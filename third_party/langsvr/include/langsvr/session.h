@@ -71,6 +71,14 @@ class Session {
     /// @return success or failure
     Result<SuccessType> Receive(std::string_view json);
 
+    /// Receive handles the already decoded LSP message @p object, calling the appropriate
+    /// registered message handler, and sending the response to the registered Sender if the message
+    /// was an LSP request.
+    /// @param object the incoming message.
+    /// @param json_builder the builder used to encode the response.
+    /// @return success or failure
+    Result<SuccessType> Receive(const json::Value& object, json::Builder& json_builder);
+
     /// Send dispatches to either SendRequest() or SetNotification based on the type of T.
     /// @param message the Request or Notification message
     /// @return the return value of either SendRequest() and SendNotification()
@@ -37,10 +37,13 @@ Result<SuccessType> Session::Receive(std::string_view json) {
     if (object != Success) {
         return object.Failure();
     }
+    return Receive(*object.Get(), *json_builder.get());
+}
 
-    auto method = object.Get()->Get<json::String>("method");
+Result<SuccessType> Session::Receive(const json::Value& object, json::Builder& json_builder) {
+    auto method = object.Get<json::String>("method");
     if (method != Success) {  // Response
-        auto id = object.Get()->Get<json::I64>("id");
+        auto id = object.Get<json::I64>("id");
         if (id != Success) {
             return id.Failure();
         }
@@ -53,11 +56,11 @@ Result<SuccessType> Session::Receive(std::string_view json) {
 
         auto handler = std::move(handler_it->second);
         response_handlers_.erase(handler_it);
-        return handler(*object.Get());
+        return handler(object);
     }
 
-    if (object.Get()->Has("id")) {  // Request
-        auto id = object.Get()->Get<json::I64>("id");
+    if (object.Has("id")) {  // Request
+        auto id = object.Get<json::I64>("id");
         if (id != Success) {
             return id.Failure();
         }
@@ -68,18 +71,18 @@ Result<SuccessType> Session::Receive(std::string_view json) {
         }
         auto& request_handler = it->second;
 
-        auto result = request_handler.function(*object.Get(), *json_builder.get());
+        auto result = request_handler.function(object, json_builder);
         if (result != Success) {
             return result.Failure();
         }
 
         std::array response_members{
-            json::Builder::Member{"id", json_builder->I64(id.Get())},
-            json::Builder::Member{"jsonrpc", json_builder->String("2.0")},
+            json::Builder::Member{"id", json_builder.I64(id.Get())},
+            json::Builder::Member{"jsonrpc", json_builder.String("2.0")},
             result.Get(),
         };
 
-        auto* response = json_builder->Object(response_members);
+        auto* response = json_builder.Object(response_members);
         if (auto res = SendJson(response->Json()); res != Success) {
             return res.Failure();
         }
@@ -93,7 +96,7 @@ Result<SuccessType> Session::Receive(std::string_view json) {
             return Failure{"no handler registered for request method '" + method.Get() + "'"};
         }
         auto& notification_handler = it->second;
-        return notification_handler.function(*object.Get());
+        return notification_handler.function(object);
     }
 
     return Success;